@@ -1,87 +1,620 @@
 #include <stdlib.h> //import for min, max, etc.
 #include <string.h>
 #include <math.h>
+#include <stddef.h>
+#include <pthread.h> //the tile workers and the pipeline stages
+#include <stdatomic.h>
+#include <unistd.h> //counting processor cores
 
-const char *curr_img; //our always updating camera image
-int prev_img_pixels[921600] = {}; //hard coded max dimensions of our saved image
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h> //SSE2 and AVX2 intrinsics, picked at runtime
+#define HAVE_X86_KERNELS
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#include <arm_neon.h> //NEON intrinsics, always there on 64 bit ARM and checked for at runtime on 32 bit ARM
+#define HAVE_NEON_KERNEL
+#if !defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
 
-int frame_difference(const char *img_a, int img_b[]); //function to show the difference between two images
+#define FRAME_POOL_SIZE 5 //camera frames of history kept, at least two (the current one and the one before); the pipeline needs one being captured, one waiting, the two being compared and one on screen
+#define DIFF_IMAGES 3 //difference images: one being computed, one waiting to be shown and one on screen
+#define QUEUE_LENGTH 1 //frames waiting between two pipeline stages; a stage that finds the queue full drops the oldest waiting frame
+#define MAX_TILE_WORKERS 16 //most threads in the tile pool
+#define MAX_TILES 64 //most row bands one frame is split into
+#define MIN_TILE_BYTES 65536 //a band smaller than this isn't worth handing to another core
+
+//the frame pool: the capture layer owns these frames and reuses them in turn, so keeping a frame is a pointer, not a copy
+unsigned char *frame_pool[FRAME_POOL_SIZE]; //each frame_bytes long, BGR
+int frame_bytes = 0; //size of one frame, set by open_frame_pool()
+int newest_frame = -1; //slot of the latest captured frame, -1 before the first one
+int frames_captured = 0; //frames captured since the pool was opened
+int frame_width = 0, frame_height = 0;
+unsigned char *diff_images[DIFF_IMAGES]; //each frame_bytes long, BGR like the camera image
+unsigned char *diff_img = NULL; //the absolute difference of every byte of the last two images, the first of diff_images
+
+int preview_scale = 1; //1 draws the difference image over the whole window; 2, 4, ... draws it that many times smaller in the top left corner, over the camera image
+unsigned char *preview_img = NULL; //the shrunken difference image, BGR
+
+int open_frame_pool(int width, int height); //make room for frames of this size
+int capture_frame(); //grab a new camera frame into the pool
+const unsigned char *frame_history(int age); //the frame captured age frames ago, 0 is the latest
+void close_frame_pool();
+void show_difference(const unsigned char *diff, int width, int height); //draw a difference image with a single blit
+int difference_image(const unsigned char *img_a, const unsigned char *img_b, unsigned char *diff); //compute the difference between two images into diff, returns the average difference
+int frame_difference(const unsigned char *img_a, const unsigned char *img_b); //function to show the difference between two images
+
+//a kernel writes |a[i] - b[i]| into diff[i] (if diff isn't NULL) for count bytes and returns the sum of those differences
+typedef unsigned long long (*absdiff_kernel)(const unsigned char *a, const unsigned char *b, unsigned char *diff, size_t count);
+absdiff_kernel absdiff_sum = NULL; //the fastest kernel this processor runs correctly, chosen by select_absdiff_kernel()
+const char *absdiff_name = "none";
+void select_absdiff_kernel(); //pick absdiff_sum, checked against the scalar kernel
+
+//a tile kernel processes rows [first_row, end_row) of an image as tile number tile, and keeps its results per tile so they can be combined in tile order
+typedef void (*tile_kernel)(int tile, int first_row, int end_row, void *context);
+
+//the tile pool: worker threads started once and woken for every parallel_rows() call, the calling thread works on tiles too
+int frame_tiles = 8; //row bands frame_difference() splits a frame into, at most MAX_TILES
+int tile_workers = -1; //threads in the pool, -1 until start_tile_pool() has run
+pthread_t tile_threads[MAX_TILE_WORKERS];
+pthread_mutex_t tile_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t tile_start = PTHREAD_COND_INITIALIZER; //a new job is there
+pthread_cond_t tile_finish = PTHREAD_COND_INITIALIZER; //the last tile of the job is done, or the last busy worker is idle again
+unsigned long tile_generation = 0; //jobs handed out so far, guarded by tile_lock
+int tile_busy = 0; //workers between picking up a job and being done with it, guarded by tile_lock; a new job is only set up once this is 0
+tile_kernel tile_job; //the job: its kernel, context, rows and tiles, guarded by tile_lock
+void *tile_context;
+int tile_rows, tile_count;
+atomic_int next_tile; //the next tile of the job to claim
+atomic_int tiles_left; //tiles of the job not finished yet
+void start_tile_pool(int workers); //start the worker threads, 0 runs every tile on the calling thread
+void parallel_rows(int rows, int tiles, tile_kernel kernel, void *context); //run kernel over rows split into tiles, return once every tile is done
+
+unsigned long long tile_difference[MAX_TILES]; //frame_difference() per tile: summed difference of the band
+int tile_counted[MAX_TILES]; //and the pixels in it
+
+//a bounded queue of buffers handed from one pipeline stage to the next
+typedef struct frame_queue{
+	void *items[FRAME_POOL_SIZE]; //a ring, no queue holds more buffers than the pool has
+	int capacity;
+	int first;
+	int count;
+	int closed; //set by close_queue(), pops return NULL from then on
+	pthread_mutex_t lock;
+	pthread_cond_t filled;
+} frame_queue;
+
+typedef struct pipeline_frame{ //a camera frame of the pool while it moves through the pipeline
+	unsigned char *pixels;
+	atomic_int users; //stages still holding it, back on free_frames when this drops to 0
+} pipeline_frame;
+
+typedef struct pipeline_image{ //a difference image on its way to the screen
+	unsigned char *pixels;
+	pipeline_frame *frame; //the camera frame to draw under a preview, NULL without one
+	int average_difference;
+} pipeline_image;
+
+//the pipeline: capture, process and display run on their own threads and only wait on each other when a queue is empty
+pipeline_frame pipeline_frames[FRAME_POOL_SIZE];
+pipeline_image pipeline_images[DIFF_IMAGES];
+frame_queue free_frames, captured_frames; //pool frames nobody holds, and frames waiting to be processed
+frame_queue free_images, shown_images; //difference images nobody holds, and images waiting to be shown
+atomic_ulong frames_dropped; //captured frames processing never got to
+atomic_ulong images_dropped; //difference images the screen never got to
+unsigned long frames_processed = 0, images_shown = 0;
+pthread_t capture_thread, process_thread;
+int start_pipeline(); //start the capture and process stages, the calling thread becomes the display stage
+pipeline_image *next_image(); //wait for the newest difference image, NULL once the pipeline is stopped
+void release_image(pipeline_image *image); //hand a shown image back to the process stage
+void stop_pipeline();
 
 int main()
 {
-	
+
 	camera_open();
 	camera_update();
-	
+
 	printf("Camera Dimensions: %d  x %d\n", get_camera_width(), get_camera_height()); //print the dimensions of our camera just for reference
 	graphics_open(get_camera_width(), get_camera_height()); //this opens the screen up for drawing on, and sets the dimensions to the same as the camera
-	
-	curr_img = get_camera_frame(); //get the current camera frame and save it to curr_img
-	const int rgb_count = get_camera_width()*get_camera_height()*3;
-	//int prev_img_pixels[rgb_count] = {}; //make a new empty char array to hold previous images that has the same length as curr_img
+
+	select_absdiff_kernel(); //pick and check the difference kernel before the first frame
+	printf("Difference kernel: %s\n", absdiff_name);
+
+	if(!open_frame_pool(get_camera_width(), get_camera_height())){
+		printf("Not enough memory for %d frames\n", FRAME_POOL_SIZE);
+		return 1;
+	}
+	if(!start_pipeline()){ //capture and processing run on their own threads from here on
+		printf("Could not start the pipeline threads\n");
+		return 1;
+	}
 
 	while(!get_key_state('Q'))
 	{//if we have a keyboard, we can quit with the letter q, otherwise this loops perpetually
-		camera_update(); //update the camera
-		
-		for(int y=0;y<get_camera_height();y++) {
-			for(int x=0;x<get_camera_width();x++) {
-			int pixel_index= 3*(get_camera_width()*y + x); //index of pixel at row Y, column X
-			//pixel values are stored in BRG order
-			prev_img_pixels[pixel_index] = curr_img[pixel_index + 0]; //save the current image pixel into our saved pixel array
-			prev_img_pixels[pixel_index + 1] = curr_img[pixel_index + 1];
-			prev_img_pixels[pixel_index + 2] = curr_img[pixel_index + 2];
-			}
-		}
-		
-		curr_img = get_camera_frame(); //get the new curr_img
-		
-		graphics_blit_enc(get_camera_frame(), BGR, 0, 0, get_camera_width(), get_camera_height()); //send our normal camera image to the graphics drawer
-		
-		frame_difference( curr_img, prev_img_pixels); //get our frame difference if we have more than one frame
-		
+		pipeline_image *image = next_image(); //the display stage: the newest difference image, while the next frames are already being captured and compared
+		if(!image) break;
+
+		if(image->frame) graphics_blit_enc(image->frame->pixels, BGR, 0, 0, frame_width, frame_height); //send our normal camera image to the graphics drawer, unless the difference image covers all of it
+
+		show_difference(image->pixels, frame_width, frame_height);
+
 		graphics_update();
+		release_image(image);
+		images_shown++;
 }
-	
+
+	stop_pipeline();
+	printf("Captured %d frames, processed %lu and showed %lu; dropped %lu before processing and %lu before display\n", frames_captured, frames_processed,
+		images_shown, (unsigned long)atomic_load(&frames_dropped), (unsigned long)atomic_load(&images_dropped));
+
 	camera_close();
 	graphics_close();
-	
+	close_frame_pool();
+
 	return 0;
 }
 
-int frame_difference(const char *img_a, int img_b[]){ //a function to get the difference between two images
-	int num_counted = 0; //store how many we have counted
-	int total_difference = 0; //store the total difference for later taking an average
-	for(int y=0;y<get_camera_height();y++) {
-		for(int x=0;x<get_camera_width();x++) {
-			int pixel_index= 3*(get_camera_width()*y + x); // index of pixel to paint into row r, column c
-			//pixel values are stored in BRG order
-			int a_pixel_blue = img_a[pixel_index + 0];
-			int a_pixel_green = img_a[pixel_index + 1];
-			int a_pixel_red = img_a[pixel_index + 2];
-			
-			int b_pixel_blue = img_b[pixel_index + 0];
-			int b_pixel_green = img_b[pixel_index + 1];
-			int b_pixel_red = img_b[pixel_index + 2];
-			
-			float a_brightness = (float)(a_pixel_blue + a_pixel_green + a_pixel_red)/3.0;
-			float b_brightness = (float)(b_pixel_blue + b_pixel_green + b_pixel_red)/3.0;
-			
-			//if(x == 0 && y == 0){
-			//	printf("a: %d, b: %d\n", a_pixel_blue, b_pixel_blue);
-			//}
-			
-			int blue_diff = fabs(b_pixel_blue - a_pixel_blue);
-			int green_diff = fabs(b_pixel_green - a_pixel_green);
-			int red_diff = fabs(b_pixel_red - a_pixel_red);
-
-			graphics_pixel(x,y,red_diff,green_diff, blue_diff);
-			
-			total_difference += blue_diff + green_diff + red_diff;
-			num_counted++;
+//========================================//
+//===============FRAME POOL===============//
+//========================================//
+
+int open_frame_pool(int width, int height){ //allocate the frames and the difference image once, up front; returns 0 if there isn't enough memory
+	close_frame_pool();
+	frame_bytes = width*height*3;
+	frame_width = width;
+	frame_height = height;
+	for(int i=0;i<FRAME_POOL_SIZE;i++){
+		frame_pool[i] = malloc(frame_bytes);
+		if(!frame_pool[i]) return 0;
+	}
+	for(int i=0;i<DIFF_IMAGES;i++){
+		diff_images[i] = malloc(frame_bytes);
+		if(!diff_images[i]) return 0;
+	}
+	diff_img = diff_images[0];
+	if(preview_scale > 1) preview_img = malloc((width/preview_scale)*(height/preview_scale)*3);
+	return preview_scale <= 1 || preview_img != NULL;
+}
+
+void close_frame_pool(){
+	for(int i=0;i<FRAME_POOL_SIZE;i++){
+		free(frame_pool[i]);
+		frame_pool[i] = NULL;
+	}
+	for(int i=0;i<DIFF_IMAGES;i++){
+		free(diff_images[i]);
+		diff_images[i] = NULL;
+	}
+	diff_img = NULL;
+	free(preview_img);
+	preview_img = NULL;
+	frame_bytes = 0;
+	frame_width = frame_height = 0;
+	newest_frame = -1;
+	frames_captured = 0;
+}
+
+int copy_camera_frame(unsigned char *into){ //update the camera and copy its frame; returns 0 if there was no frame
+	if(!camera_update()) return 0;
+	const unsigned char *frame = get_camera_frame();
+	if(!frame || get_camera_width()*get_camera_height()*3 != frame_bytes) return 0;
+	memcpy(into, frame, frame_bytes); //the one copy we can't avoid: the library reuses its buffer at the next camera_update()
+	frames_captured++;
+	return 1;
+}
+
+int capture_frame(){ //capture into the oldest slot of the pool, which becomes the newest; not while the pipeline is running, it owns the pool then
+	int slot = (newest_frame + 1) % FRAME_POOL_SIZE;
+	if(!copy_camera_frame(frame_pool[slot])) return 0;
+	newest_frame = slot;
+	return 1;
+}
+
+const unsigned char *frame_history(int age){ //a read-only view of a frame in the pool, valid until FRAME_POOL_SIZE - age more frames are captured.  Before enough frames exist, the oldest one stands in
+	if(newest_frame < 0 || age < 0) return NULL;
+	if(age >= frames_captured) age = frames_captured - 1;
+	if(age >= FRAME_POOL_SIZE) return NULL;
+	return frame_pool[(newest_frame - age + FRAME_POOL_SIZE) % FRAME_POOL_SIZE];
+}
+
+//========================================//
+//================PIPELINE================//
+//========================================//
+
+void open_queue(frame_queue *queue, int capacity){
+	queue->capacity = capacity;
+	queue->first = 0;
+	queue->count = 0;
+	queue->closed = 0;
+	pthread_mutex_init(&queue->lock, NULL);
+	pthread_cond_init(&queue->filled, NULL);
+}
+
+void *queue_push(frame_queue *queue, void *item){ //never waits: if the queue is full its oldest item makes room and is returned, so the caller can give it back
+	void *dropped = NULL;
+	pthread_mutex_lock(&queue->lock);
+	if(queue->count == queue->capacity){
+		dropped = queue->items[queue->first];
+		queue->first = (queue->first + 1) % queue->capacity;
+		queue->count--;
+	}
+	queue->items[(queue->first + queue->count) % queue->capacity] = item;
+	queue->count++;
+	pthread_cond_signal(&queue->filled);
+	pthread_mutex_unlock(&queue->lock);
+	return dropped;
+}
+
+void *queue_pop(frame_queue *queue){ //wait for the oldest item, NULL once the queue is closed
+	void *item = NULL;
+	pthread_mutex_lock(&queue->lock);
+	while(queue->count == 0 && !queue->closed) pthread_cond_wait(&queue->filled, &queue->lock);
+	if(!queue->closed){
+		item = queue->items[queue->first];
+		queue->first = (queue->first + 1) % queue->capacity;
+		queue->count--;
+	}
+	pthread_mutex_unlock(&queue->lock);
+	return item;
+}
+
+void close_queue(frame_queue *queue){ //wake every stage waiting on the queue
+	pthread_mutex_lock(&queue->lock);
+	queue->closed = 1;
+	pthread_cond_broadcast(&queue->filled);
+	pthread_mutex_unlock(&queue->lock);
+}
+
+void destroy_queue(frame_queue *queue){
+	pthread_mutex_destroy(&queue->lock);
+	pthread_cond_destroy(&queue->filled);
+}
+
+void release_frame(pipeline_frame *frame){ //the last stage to let go of a frame gives it back to the capture stage
+	if(atomic_fetch_sub(&frame->users, 1) == 1) queue_push(&free_frames, frame);
+}
+
+void release_image(pipeline_image *image){
+	if(image->frame) release_frame(image->frame);
+	image->frame = NULL;
+	queue_push(&free_images, image);
+}
+
+void *capture_stage(void *unused){ //camera_update() and the copy out of the library's buffer, into any frame nobody holds
+	(void)unused;
+	pipeline_frame *frame;
+	while((frame = queue_pop(&free_frames))){
+		if(!copy_camera_frame(frame->pixels)){
+			queue_push(&free_frames, frame);
+			continue;
+		}
+		atomic_store(&frame->users, 1); //held by the process stage from now on
+		pipeline_frame *dropped = queue_push(&captured_frames, frame);
+		if(dropped){ //processing fell behind, the newest frame is the one worth comparing
+			atomic_fetch_add(&frames_dropped, 1);
+			release_frame(dropped);
 		}
 	}
-	
-	int average_difference = total_difference / num_counted;
+	return NULL;
+}
+
+void *process_stage(void *unused){ //the difference of each frame with the one processed before it
+	(void)unused;
+	pipeline_frame *previous = NULL, *frame;
+	while((frame = queue_pop(&captured_frames))){
+		if(previous){
+			pipeline_image *image = queue_pop(&free_images);
+			if(!image){
+				release_frame(frame);
+				break;
+			}
+			image->average_difference = difference_image(frame->pixels, previous->pixels, image->pixels);
+			if(preview_scale > 1){ //the display stage draws the camera frame under the preview
+				atomic_fetch_add(&frame->users, 1);
+				image->frame = frame;
+			}
+			frames_processed++;
+			pipeline_image *dropped = queue_push(&shown_images, image);
+			if(dropped){ //the screen fell behind, show the newest difference instead
+				atomic_fetch_add(&images_dropped, 1);
+				release_image(dropped);
+			}
+			release_frame(previous);
+		}
+		previous = frame;
+	}
+	if(previous) release_frame(previous);
+	return NULL;
+}
+
+int start_pipeline(){ //every pool frame and difference image starts out free; the frame pool must be open
+	open_queue(&free_frames, FRAME_POOL_SIZE); //as long as the pool, so giving a frame back never drops one
+	open_queue(&captured_frames, QUEUE_LENGTH);
+	open_queue(&free_images, DIFF_IMAGES);
+	open_queue(&shown_images, QUEUE_LENGTH);
+	for(int i=0;i<FRAME_POOL_SIZE;i++){
+		pipeline_frames[i].pixels = frame_pool[i];
+		atomic_store(&pipeline_frames[i].users, 0);
+		queue_push(&free_frames, &pipeline_frames[i]);
+	}
+	for(int i=0;i<DIFF_IMAGES;i++){
+		pipeline_images[i].pixels = diff_images[i];
+		pipeline_images[i].frame = NULL;
+		queue_push(&free_images, &pipeline_images[i]);
+	}
+	atomic_store(&frames_dropped, 0);
+	atomic_store(&images_dropped, 0);
+	frames_processed = images_shown = 0;
+	if(pthread_create(&capture_thread, NULL, capture_stage, NULL) != 0) return 0;
+	if(pthread_create(&process_thread, NULL, process_stage, NULL) != 0){
+		close_queue(&free_frames);
+		pthread_join(capture_thread, NULL);
+		return 0;
+	}
+	return 1;
+}
+
+pipeline_image *next_image(){
+	return queue_pop(&shown_images);
+}
+
+void stop_pipeline(){ //close every queue so no stage can wait forever, then wait for the stages to finish their current frame
+	close_queue(&free_frames);
+	close_queue(&captured_frames);
+	close_queue(&free_images);
+	close_queue(&shown_images);
+	pthread_join(capture_thread, NULL);
+	pthread_join(process_thread, NULL);
+	destroy_queue(&free_frames);
+	destroy_queue(&captured_frames);
+	destroy_queue(&free_images);
+	destroy_queue(&shown_images);
+}
+
+//========================================//
+//===============TILE POOL================//
+//========================================//
+
+void run_tiles(tile_kernel kernel, void *context, int rows, int tiles){ //claim and run tiles of the current job until there are none left
+	int tile;
+	while((tile = atomic_fetch_add(&next_tile, 1)) < tiles){
+		kernel(tile, (int)((long long)rows*tile/tiles), (int)((long long)rows*(tile + 1)/tiles), context);
+		if(atomic_fetch_sub(&tiles_left, 1) == 1){ //the last tile of the job
+			pthread_mutex_lock(&tile_lock);
+			pthread_cond_broadcast(&tile_finish);
+			pthread_mutex_unlock(&tile_lock);
+		}
+	}
+}
+
+void *tile_worker(void *unused){ //body of every pool thread: sleep until a job comes, help with it, repeat
+	(void)unused;
+	unsigned long seen = 0;
+	while(1){
+		pthread_mutex_lock(&tile_lock);
+		while(tile_generation == seen) pthread_cond_wait(&tile_start, &tile_lock);
+		seen = tile_generation;
+		tile_busy++;
+		tile_kernel kernel = tile_job; //take a copy of the job while nobody can change it
+		void *context = tile_context;
+		int rows = tile_rows, tiles = tile_count;
+		pthread_mutex_unlock(&tile_lock);
+
+		run_tiles(kernel, context, rows, tiles);
+
+		pthread_mutex_lock(&tile_lock);
+		if(--tile_busy == 0) pthread_cond_broadcast(&tile_finish);
+		pthread_mutex_unlock(&tile_lock);
+	}
+	return NULL;
+}
+
+void start_tile_pool(int workers){ //started once, threads are never created per frame
+	if(tile_workers >= 0) return;
+	if(workers > MAX_TILE_WORKERS) workers = MAX_TILE_WORKERS;
+	tile_workers = 0;
+	for(int i=0;i<workers;i++){
+		if(pthread_create(&tile_threads[i], NULL, tile_worker, NULL) != 0) break; //fewer workers is still correct, only slower
+		tile_workers++;
+	}
+}
+
+void parallel_rows(int rows, int tiles, tile_kernel kernel, void *context){ //tile t covers rows [rows*t/tiles, rows*(t+1)/tiles)
+	if(tile_workers < 0) start_tile_pool(sysconf(_SC_NPROCESSORS_ONLN) - 1); //one thread per core, counting this one
+	if(tiles <= 1 || tile_workers == 0){ //not worth waking anyone
+		for(int tile=0;tile<tiles;tile++) kernel(tile, (int)((long long)rows*tile/tiles), (int)((long long)rows*(tile + 1)/tiles), context);
+		return;
+	}
+	pthread_mutex_lock(&tile_lock);
+	while(tile_busy > 0) pthread_cond_wait(&tile_finish, &tile_lock); //a worker still finishing the last job could otherwise claim a tile of this one
+	tile_job = kernel;
+	tile_context = context;
+	tile_rows = rows;
+	tile_count = tiles;
+	atomic_store(&tiles_left, tiles);
+	atomic_store(&next_tile, 0);
+	tile_generation++;
+	pthread_cond_broadcast(&tile_start);
+	pthread_mutex_unlock(&tile_lock);
+
+	run_tiles(kernel, context, rows, tiles);
+	pthread_mutex_lock(&tile_lock);
+	while(atomic_load(&tiles_left) > 0) pthread_cond_wait(&tile_finish, &tile_lock);
+	pthread_mutex_unlock(&tile_lock);
+}
+
+//========================================//
+//=========ABSOLUTE DIFFERENCE KERNELS====//
+//========================================//
+
+unsigned long long absdiff_scalar(const unsigned char *a, const unsigned char *b, unsigned char *diff, size_t count){ //the reference every other kernel has to match
+	unsigned long long total = 0;
+	for(size_t i=0;i<count;i++){
+		int d = a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+		if(diff) diff[i] = d;
+		total += d;
+	}
+	return total;
+}
+
+#ifdef HAVE_X86_KERNELS
+__attribute__((target("sse2")))
+unsigned long long absdiff_sse2(const unsigned char *a, const unsigned char *b, unsigned char *diff, size_t count){
+	__m128i sum = _mm_setzero_si128(); //two 64 bit running sums
+	size_t i = 0;
+	for(;i+16<=count;i+=16){
+		__m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+		__m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+		if(diff) _mm_storeu_si128((__m128i *)(diff + i), _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va))); //one of the saturated differences is zero, the other is |a - b|
+		sum = _mm_add_epi64(sum, _mm_sad_epu8(va, vb)); //sum of absolute differences of each 8 byte half
+	}
+	unsigned long long lanes[2];
+	_mm_storeu_si128((__m128i *)lanes, sum);
+	return lanes[0] + lanes[1] + absdiff_scalar(a + i, b + i, diff ? diff + i : NULL, count - i);
+}
+
+__attribute__((target("avx2")))
+unsigned long long absdiff_avx2(const unsigned char *a, const unsigned char *b, unsigned char *diff, size_t count){
+	__m256i sum = _mm256_setzero_si256(); //four 64 bit running sums
+	size_t i = 0;
+	for(;i+32<=count;i+=32){
+		__m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+		__m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+		if(diff) _mm256_storeu_si256((__m256i *)(diff + i), _mm256_or_si256(_mm256_subs_epu8(va, vb), _mm256_subs_epu8(vb, va)));
+		sum = _mm256_add_epi64(sum, _mm256_sad_epu8(va, vb));
+	}
+	__m128i half = _mm_add_epi64(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+	unsigned long long lanes[2];
+	_mm_storeu_si128((__m128i *)lanes, half);
+	return lanes[0] + lanes[1] + absdiff_scalar(a + i, b + i, diff ? diff + i : NULL, count - i);
+}
+#endif
+
+#ifdef HAVE_NEON_KERNEL
+unsigned long long absdiff_neon(const unsigned char *a, const unsigned char *b, unsigned char *diff, size_t count){
+	uint64x2_t sum = vdupq_n_u64(0);
+	size_t i = 0;
+	while(i+16<=count){
+		uint16x8_t block = vdupq_n_u16(0); //16 bit sums, at most 128 blocks of 16 bytes fit before they could overflow
+		for(int n=0;n<128 && i+16<=count;n++,i+=16){
+			uint8x16_t d = vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i)); //byte-wise |a - b|
+			if(diff) vst1q_u8(diff + i, d);
+			block = vpadalq_u8(block, d); //add neighbouring pairs into the 16 bit sums
+		}
+		sum = vpadalq_u32(sum, vpaddlq_u16(block)); //widen and fold the block into the 64 bit sums
+	}
+	unsigned long long total = vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1);
+	return total + absdiff_scalar(a + i, b + i, diff ? diff + i : NULL, count - i);
+}
+#endif
+
+int absdiff_kernel_matches(absdiff_kernel kernel){ //compare a kernel with the scalar one bit for bit, on data that covers every byte value and an uneven tail
+	enum { TEST_BYTES = 4096 + 45 };
+	static unsigned char a[TEST_BYTES], b[TEST_BYTES], expected[TEST_BYTES], actual[TEST_BYTES];
+	unsigned int seed = 12345;
+	for(int i=0;i<TEST_BYTES;i++){
+		seed = seed*1103515245u + 12345u;
+		a[i] = seed >> 24;
+		b[i] = i < 512 ? 255 - a[i] : (seed >> 16) & 0xFF; //the first 512 bytes hit the largest differences
+	}
+	for(size_t offset=0;offset<4;offset++){ //unaligned starts too
+		size_t count = TEST_BYTES - offset;
+		unsigned long long want = absdiff_scalar(a + offset, b + offset, expected, count);
+		if(kernel(a + offset, b + offset, actual, count) != want || memcmp(actual, expected, count) != 0) return 0;
+		if(kernel(a + offset, b + offset, NULL, count) != want) return 0;
+	}
+	return 1;
+}
+
+void select_absdiff_kernel(){ //use the widest kernel the processor has, as long as it agrees with the scalar one
+	absdiff_sum = absdiff_scalar;
+	absdiff_name = "scalar";
+#ifdef HAVE_X86_KERNELS
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2") && absdiff_kernel_matches(absdiff_avx2)){
+		absdiff_sum = absdiff_avx2;
+		absdiff_name = "avx2";
+	}
+	else if(__builtin_cpu_supports("sse2") && absdiff_kernel_matches(absdiff_sse2)){
+		absdiff_sum = absdiff_sse2;
+		absdiff_name = "sse2";
+	}
+#endif
+#ifdef HAVE_NEON_KERNEL
+#if !defined(__aarch64__)
+	if(!(getauxval(AT_HWCAP) & HWCAP_NEON)) return;
+#endif
+	if(absdiff_kernel_matches(absdiff_neon)){
+		absdiff_sum = absdiff_neon;
+		absdiff_name = "neon";
+	}
+#endif
+}
+
+typedef struct difference_job{ //the two frames difference_image() hands to its tiles, and where the difference goes
+	const unsigned char *img_a;
+	const unsigned char *img_b;
+	unsigned char *diff;
+	int width;
+} difference_job;
+
+void difference_tile(int tile, int first_row, int end_row, void *context){ //the rows of a band are contiguous in memory, so a band is one kernel call
+	const difference_job *job = context;
+	size_t first = (size_t)first_row*job->width*3, count = (size_t)(end_row - first_row)*job->width*3;
+	tile_difference[tile] = absdiff_sum(job->img_a + first, job->img_b + first, job->diff + first, count);
+	tile_counted[tile] = (end_row - first_row)*job->width;
+}
+
+int difference_image(const unsigned char *img_a, const unsigned char *img_b, unsigned char *diff){ //the pool's frame size, not the library's, so the process stage never calls into the camera
+	const int width = frame_width;
+	const int height = frame_height;
+	const int num_counted = width*height; //how many pixels we compare
+	if(num_counted == 0 || !img_a || !img_b || !diff) return 0;
+	if(absdiff_sum == NULL) select_absdiff_kernel();
+
+	//split the frame into row bands for the tile pool, each band still big enough to be worth it
+	int tiles = frame_tiles;
+	if(tiles > MAX_TILES) tiles = MAX_TILES;
+	if(tiles > num_counted*3/MIN_TILE_BYTES) tiles = num_counted*3/MIN_TILE_BYTES;
+	if(tiles > height) tiles = height;
+	if(tiles < 1) tiles = 1;
+	difference_job job = {img_a, img_b, diff, width};
+	parallel_rows(height, tiles, difference_tile, &job);
+
+	unsigned long long total_difference = 0; //the total difference of all three colors of every pixel, for taking an average
+	int counted = 0;
+	for(int tile=0;tile<tiles;tile++){ //always added up in tile order, so the result doesn't depend on which thread finished first
+		total_difference += tile_difference[tile];
+		counted += tile_counted[tile];
+	}
+
+	int average_difference = total_difference / counted;
 	return average_difference;
 }
+
+int frame_difference(const unsigned char *img_a, const unsigned char *img_b){ //a function to get the difference between two images and draw it
+	int average_difference = difference_image(img_a, img_b, diff_img);
+	if(diff_img) show_difference(diff_img, frame_width, frame_height);
+	return average_difference;
+}
+
+void show_difference(const unsigned char *diff, int width, int height){ //one graphics_blit_enc of the whole difference image instead of a graphics_pixel call per pixel
+	if(preview_scale <= 1 || !preview_img){
+		graphics_blit_enc(diff, BGR, 0, 0, width, height);
+		return;
+	}
+	const int scale = preview_scale;
+	const int preview_width = width/scale, preview_height = height/scale;
+	for(int py=0;py<preview_height;py++) {
+		const unsigned char *in = diff + 3*width*(py*scale); //every scale-th pixel of every scale-th row, so shrinking costs far less than drawing the full image would
+		unsigned char *out = preview_img + 3*preview_width*py;
+		for(int px=0;px<preview_width;px++) {
+			out[3*px + 0] = in[3*scale*px + 0];
+			out[3*px + 1] = in[3*scale*px + 1];
+			out[3*px + 2] = in[3*scale*px + 2];
+		}
+	}
+	graphics_blit_enc(preview_img, BGR, 0, 0, preview_width, preview_height);
+}
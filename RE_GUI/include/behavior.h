@@ -0,0 +1,33 @@
+/*
+Vassar Cognitive Science - Robot Ethology
+
+The behavior type keys and the behavior struct of RE_GUI's subsumption hierarchy.  Shared with the simulator's batch tools
+(RE_Sim/src/robot.c), which rearrange the hierarchy and need the same layout and keys.
+*/
+
+#ifndef RE_BEHAVIOR_H
+#define RE_BEHAVIOR_H
+
+#include <stdbool.h>
+
+// *** Define integer keys for each action type *** //
+#define SEEK_LIGHT_TYPE 0
+#define SEEK_DARK_TYPE 1
+#define APPROACH_TYPE 2
+#define AVOID_TYPE 3
+#define ESCAPE_F_TYPE 4
+#define ESCAPE_B_TYPE 5
+#define CRUISE_S_TYPE 6
+#define CRUISE_A_TYPE 7
+#define MOTION_TYPE 8
+#define BEHAVIOR_TYPE_COUNT 9 // one more than the largest type key, sizes the per-type tables of RE_GUI
+
+// *** Define a new kind of variable type called "behavior" that contains properties for type (indexing definitions above), rank, and an active/inactive boolean *** //
+typedef struct behavior{
+	const char *title;
+	int type;
+	int rank;
+	bool is_active;
+} behavior;
+
+#endif
@@ -0,0 +1,58 @@
+/*
+Vassar Cognitive Science - Robot Ethology
+
+Layout of the profile file kept by RE_GUI: a header followed by a few named slots, each holding a hierarchy (order and active
+flags) and the thresholds it was run with.  Every slot is kept as PROFILE_COPIES copies; a save overwrites the older one, so the
+configuration saved before it survives a save that never completes.  The file is memory mapped, so restoring a slot at boot is a
+check of the checksums and a copy, and saving one after a change in the menu is a copy into memory.
+*/
+
+#ifndef RE_PROFILE_H
+#define RE_PROFILE_H
+
+#include <stdint.h>
+
+#define PROFILE_MAGIC "REPROFL"	// 7 characters and a zero
+#define PROFILE_VERSION 3		// 2 added the MOTION behavior's threshold and direction, 3 the second copy of every slot
+#define PROFILE_SLOTS 4			// named slots in a file
+#define PROFILE_COPIES 2		// copies kept of every slot, one after the other
+#define PROFILE_NAME_LENGTH 16	// including the terminating zero
+#define PROFILE_BEHAVIORS 16	// room for more behavior types than there are now
+
+// *** Define the profile file header *** //
+typedef struct profile_header{
+	char magic[8];			// PROFILE_MAGIC
+	uint32_t version;		// PROFILE_VERSION
+	uint32_t slot_size;		// sizeof(profile_slot)
+	uint32_t slot_count;	// PROFILE_SLOTS
+	int32_t current_slot;	// the slot saved or restored last, resumed at the next boot
+	uint8_t padding[8];
+} profile_header;			// 32 bytes
+
+// *** Define a copy of a profile slot: one saved configuration *** //
+typedef struct profile_slot{
+	uint32_t checksum;		// profile_checksum() of the copy, a copy that doesn't match (never saved, or its save cut short) is not restored
+	uint32_t saves;			// times the slot had been saved when this copy was written, 0 if never; the valid copy with more is the newer
+	char name[PROFILE_NAME_LENGTH]; // empty for a free slot
+	int32_t avoid_threshold;
+	int32_t approach_threshold;
+	int32_t photo_threshold;
+	uint32_t behavior_count; // entries used in types and active
+	int8_t types[PROFILE_BEHAVIORS];	// type keys of the hierarchy, top down
+	uint8_t active[PROFILE_BEHAVIORS];	// whether each of them is active
+	int32_t motion_threshold;
+	uint8_t motion_attracts;	// 1 turns toward motion, 0 away from it
+	uint8_t padding[3];
+} profile_slot;				// 80 bytes
+
+// FNV-1a over everything in the slot after the checksum
+static inline uint32_t profile_checksum(const profile_slot *slot)
+{
+	const uint8_t *byte = (const uint8_t *)slot + sizeof(slot->checksum);
+	const uint8_t *end = (const uint8_t *)(slot + 1);
+	uint32_t hash = 2166136261u;
+	while (byte < end) hash = (hash ^ *byte++) * 16777619u;
+	return hash;
+}
+
+#endif
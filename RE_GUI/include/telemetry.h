@@ -0,0 +1,51 @@
+/*
+Vassar Cognitive Science - Robot Ethology
+
+Layout of the telemetry file written by RE_GUI: a header followed by a ring of fixed size records, one per control tick.
+The file is memory mapped while the robot runs, so logging a tick is a copy into memory and never a system call.
+Shared with the decoder (RE_Sim/src/telemetry_main.c), which turns a telemetry file into CSV.
+*/
+
+#ifndef RE_TELEMETRY_H
+#define RE_TELEMETRY_H
+
+#include <stdint.h>
+
+#define TELEMETRY_MAGIC "RETELEM"	// 7 characters and a zero
+#define TELEMETRY_VERSION 2
+
+#define TELEMETRY_NO_ARBITRATION -1 // winner of a tick on which an action was still running, so nothing was chosen
+#define TELEMETRY_STOPPED -2		// winner of a tick on which no active behavior fired and the robot stopped
+
+// *** Define the telemetry file header *** //
+typedef struct telemetry_header{
+	char magic[8];				// TELEMETRY_MAGIC
+	uint32_t version;			// TELEMETRY_VERSION
+	uint32_t record_size;		// sizeof(telemetry_record)
+	uint32_t capacity;			// records in the ring, the newest is at record_count - 1 modulo capacity
+	uint32_t reserved;
+	volatile uint64_t record_count; // total records ever written, updated after each record is complete
+	uint8_t padding[32];		// the records start on a cache line
+} telemetry_header;
+
+// *** Define a telemetry record: what one control tick saw and did *** //
+typedef struct telemetry_record{
+	uint64_t timestamp;			// monotonic time of the sensor snapshot the tick used (microseconds)
+	uint32_t tick;				// control loop tick number
+	int32_t timer_duration;		// duration (ms) of the phase running at the end of the tick
+	int16_t right_photo;		// *** NOTE: greater value means less light ***
+	int16_t left_photo;
+	int16_t right_ir;
+	int16_t left_ir;
+	int16_t left_position;		// servo positions at the end of the tick, -1 if never written
+	int16_t right_position;
+	uint16_t left_motion;		// motion scores of the left and right half of the camera image (0 to 255)
+	uint16_t right_motion;
+	uint8_t bumps;				// *_BUMP_BIT flags of the pressed bumpers
+	uint8_t sensors_read;		// *_SENSORS groups actually read this tick, the other sensor values are stale
+	int8_t winner;				// type key of the behavior whose action started this tick, or TELEMETRY_NO_ARBITRATION / TELEMETRY_STOPPED
+	uint8_t phase;				// phase of the running action at the end of the tick
+	uint8_t padding[4];
+} telemetry_record;				// 40 bytes
+
+#endif
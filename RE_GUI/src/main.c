@@ -2,11 +2,13 @@
 Vassar Cognitive Science - Robot Ethology
 
 This program operates a kipr-link-based robot (equipped with analog photo, ir, contact sensors) based on a specified subsumption hierarchy.
-The initial behavior at program execution uses the hard coded behaviors listed in the "subsumption_hierarchy" array.
+At program execution the hierarchy and thresholds saved in the profile file (profile_path) are restored; without a saved profile the
+program starts from the hard coded behaviors listed in the "subsumption_hierarchy" array.
 Behaviors can be edited and altered by pressing the side button on the link and altered using the buttons on the screen.
 Once set, the side button can be pressed again to return to execution mode.
 
-To prevent students from knowing the boot behavior, the subsumption_hierarchy is randomized after the first button press.  However, this behavior can be restored by simply restarting the program.
+Every change made on the screen is saved to the profile, so restarting the program resumes the edited hierarchy rather than the hard
+coded one.  To boot from the hard coded hierarchy again, set use_profiles to false or delete the profile file.
 
 Course:			211 - Perception & Action
 Instructors:	Ken Livingston
@@ -20,16 +22,19 @@ Revisions:	    Earlier version (2018) and revisions (2023) by Nick Livingston
 #include <kipr/wombat.h> // KIPR Wombat native library
 #include <stdlib.h>	 // library for general purpose functions
 #include <stdbool.h> // library for boolean support
-
-// *** Define integer keys for each action type *** //
-#define SEEK_LIGHT_TYPE 0
-#define SEEK_DARK_TYPE 1
-#define APPROACH_TYPE 2
-#define AVOID_TYPE 3
-#define ESCAPE_F_TYPE 4
-#define ESCAPE_B_TYPE 5
-#define CRUISE_S_TYPE 6
-#define CRUISE_A_TYPE 7
+#include <time.h>	 // library for the monotonic clock used to timestamp sensor snapshots
+#include <stdatomic.h> // library for lock-free sharing of sensor snapshots between threads
+#include <string.h>	 // library for memory copies
+#include <fcntl.h>	 // library for opening the telemetry file
+#include <unistd.h>	 // library for sizing and closing the telemetry and profile files
+#include <sys/stat.h> // library for checking the size of the profile file
+#include <sys/mman.h> // library for memory mapping the telemetry file
+#include <stdio.h>	 // library for writing latency reports to a file
+#include <signal.h>	 // library for asking for a latency report with SIGUSR1
+#include <stdarg.h>	 // library for formatting whole console rows
+#include "telemetry.h" // layout of the telemetry file, shared with the decoder
+#include "profile.h"	 // layout of the file the hierarchy and thresholds are saved in
+#include "behavior.h"	 // the action type keys and the behavior struct, shared with the simulator's batch tools
 
 // *** Define PIN Address *** //
 
@@ -48,13 +53,114 @@ Revisions:	    Earlier version (2018) and revisions (2023) by Nick Livingston
 #define RIGHT_MOTOR_PIN 0
 #define LEFT_MOTOR_PIN 1 // servos
 
-// *** Define a new kind of variable type called "behavior" that contains properties for type (indexing definitions above), rank, and an active/inactive boolean *** //
-typedef struct behavior{
-	const char *title;
+// *** Define bit masks for each bumper in a sensor snapshot *** //
+#define FRONT_BUMP_LEFT_BIT 0x01
+#define FRONT_BUMP_CENTER_BIT 0x02
+#define FRONT_BUMP_RIGHT_BIT 0x04
+#define BACK_BUMP_LEFT_BIT 0x08
+#define BACK_BUMP_CENTER_BIT 0x10
+#define BACK_BUMP_RIGHT_BIT 0x20
+#define FRONT_BUMP_BITS (FRONT_BUMP_LEFT_BIT | FRONT_BUMP_CENTER_BIT | FRONT_BUMP_RIGHT_BIT)
+#define BACK_BUMP_BITS (BACK_BUMP_LEFT_BIT | BACK_BUMP_CENTER_BIT | BACK_BUMP_RIGHT_BIT)
+
+// *** Define bit masks for each group of sensors a behavior can depend on, the unit in which sensors are read *** //
+#define PHOTO_SENSORS 0x01
+#define IR_SENSORS 0x02
+#define FRONT_BUMP_SENSORS 0x04
+#define BACK_BUMP_SENSORS 0x08
+#define VISION_SENSORS 0x10 // the motion scores of the vision thread, reading them never touches the camera
+#define ALL_SENSORS 0x1F
+#define SENSOR_GROUP_COUNT 5
+
+#define SENSOR_HISTORY_LENGTH 64 // how many past snapshots are kept, must be a power of two
+#define MAX_ACTION_PHASES 4		 // the most timed motor phases one action can chain together
+#define TELEMETRY_RECORDS 65536	 // control ticks kept in the telemetry file, about 11 minutes at 100 Hz
+#define LOG_QUEUE_LENGTH 256	 // log events waiting for the logger thread, must be a power of two
+#define MOTION_GRID_COLUMNS 16	 // the camera image is shrunk to this grid of cells before two frames are compared
+#define MOTION_GRID_ROWS 12
+
+// *** Define the stages of a control tick whose durations are kept in latency histograms *** //
+#define GUI_STAGE 0			// update_gui()
+#define CONSOLE_STAGE 1		// print_set_hierarchy(), and re-enabling the motors after the menu
+#define SENSOR_STAGE 2		// getting a snapshot, plus the sensor reads arbitration makes without the acquisition thread
+#define ARBITRATION_STAGE 3	// arbitrate() or check_preemption(), without their sensor reads; drive() only collects the command here
+#define COMMIT_STAGE 4		// commit_motor_command(), where the servos are written
+#define TICK_STAGE 5		// the whole tick, from waking up to going back to sleep
+#define STAGE_COUNT 6
+#define LATENCY_SUB_BUCKETS 16 // buckets per power of two, so a reported time is at most 1/16 (6%) above the real one
+#define LATENCY_BUCKETS (33 * LATENCY_SUB_BUCKETS) // exact below 16 ns, then up to 2^36 ns (about a minute); longer times land in the last bucket
+#define LATENCY_COMBO_TICKS 25 // control ticks between looks at the A + C combo, a quarter of a second at 100 Hz
+
+// *** Define keys for the on-screen buttons whose text is cached *** //
+#define A_BUTTON 0
+#define B_BUTTON 1
+#define C_BUTTON 2
+#define X_BUTTON 3
+#define Y_BUTTON 4
+#define Z_BUTTON 5
+#define BUTTON_COUNT 6
+#define SCREEN_ROWS 16	  // console rows whose contents are cached, rows below are always written
+#define SCREEN_COLUMNS 80 // longest row that is cached
+
+// *** Define log calls, compile with -DNO_LOGGING to strip every one of them *** //
+#ifdef NO_LOGGING
+#define LOG_VALUES(format, a, b, c) ((void)0)
+#else
+#define LOG_VALUES(format, a, b, c) log_values(format, a, b, c)
+#endif
+
+// *** Define a sensor snapshot: every sensor reading taken in one batch, with the time it was taken *** //
+typedef struct sensor_snapshot{
+	unsigned long long timestamp; // monotonic time the batch was read (microseconds)
+	int right_photo;			  // *** NOTE: greater value means less light ***
+	int left_photo;
+	int right_ir;
+	int left_ir;
+	unsigned char bumps;		  // one *_BUMP_BIT per bumper, set while that bumper is pressed (digital reads 0)
+	unsigned char sensors_read;	  // which *_SENSORS groups were read into this snapshot, the other values are left over from an older one
+	unsigned short left_motion;	  // average change of a grid cell between the last two camera frames, on the left half of the image (0 to 255)
+	unsigned short right_motion;  // and on the right half
+} __attribute__((aligned(32))) sensor_snapshot; // 32 bytes, so two snapshots share a cache line and none straddles one
+typedef unsigned int __attribute__((may_alias)) snapshot_word; // the unit a snapshot shared between threads is copied in
+
+// *** Define a log event: a printf format and up to three integers, formatted later by the logger thread *** //
+typedef struct log_event{
+	const char *format; // only the pointer is queued, so this must be a string literal
+	int values[3];
+} log_event;
+
+// *** Define a latency histogram: how often a stage took each range of nanoseconds, log-linear buckets in the style of HdrHistogram *** //
+typedef struct latency_histogram{
+	unsigned long count;			  // durations recorded
+	unsigned long long max;			  // the longest one, exactly
+	unsigned int buckets[LATENCY_BUCKETS];
+} latency_histogram;
+
+// *** Define a compiled behavior: an active behavior reduced to its type and the action it runs *** //
+typedef struct compiled_behavior{
 	int type;
-	int rank;
-	bool is_active;
-} behavior;
+	void (*action)(const sensor_snapshot *sensors);
+} compiled_behavior;
+
+// *** Define a motor phase: one step of an action, given the same way as the arguments of drive() *** //
+typedef struct motor_phase{
+	float left;		// left motor speed between -1 and 1
+	float right;	// right motor speed between -1 and 1
+	float seconds;	// how long this phase runs before the next one starts
+} motor_phase;
+
+// *** Define a motor command: the servo positions and duration of one phase, ready to be sent to the servos *** //
+typedef struct motor_command{
+	int left_position;	// servo position for the left motor
+	int right_position;	// servo position for the right motor
+	int duration;		// how long (ms) this phase runs
+} motor_command;
+
+// *** Define an action sequence: the motor commands of an action, run one after the other by the control loop *** //
+typedef struct action_sequence{
+	motor_command phases[MAX_ACTION_PHASES];
+	int length;			// number of phases, 0 means no action
+} action_sequence;
 
 // *** Define a comparator function used in the qsort function for sorting our behavior list.  Active things always go before inactive things, and if both are active then the are ordered by rank. *** //
 int compare_ranks(const void *a, const void *b)  
@@ -71,17 +177,100 @@ int compare_ranks(const void *a, const void *b)
 
 // *** Variable Definitions *** //
 
-// global variables to store all current sensor values accessible to all functions and updated by the "read_sensors" function
-int right_photo_value, left_photo_value, right_ir_value, left_ir_value, front_bump_left_value, front_bump_center_value, front_bump_right_value, back_bump_left_value, back_bump_center_value, back_bump_right_value;
+// sensor history: the last SENSOR_HISTORY_LENGTH snapshots, written only by publish_snapshot() so behaviors and filters can look back without reading the pins again
+sensor_snapshot sensor_history[SENSOR_HISTORY_LENGTH] __attribute__((aligned(64)));
+atomic_ulong sensor_count = 0;	 // total number of snapshots published, the newest is at sensor_history[(sensor_count - 1) % SENSOR_HISTORY_LENGTH]
+atomic_ulong sensor_claimed = 0; // total number of slots the writer has started filling, one ahead of sensor_count while a read is in progress
+
+// sensor acquisition thread
+bool use_sensor_thread = true; // sample the sensors on their own thread so a slow screen redraw can't delay sensing; false samples once per control tick instead
+int sensor_rate = 500;		   // how many times per second the acquisition thread samples every pin (Hz, 1 to 1000)
+unsigned long long max_sensor_age = 0; // the oldest (microseconds) a snapshot has been when the control loop arbitrated on it
+atomic_ulong pin_reads = 0;		   // number of analog()/digital() calls made, to see what lazy reading saves; counted by whichever thread reads the pins, shown by the control loop
+
+// vision thread
+bool use_vision = true;			  // watch the camera for motion on its own thread once MOTION is active; false leaves the camera closed and the motion scores at 0
+bool vision_started = false;	  // the camera is open and the vision thread running, from the first time an active behavior needed the motion scores
+atomic_uint motion_scores = 0;	  // the latest left motion score in the high 16 bits and right in the low 16, one word so a reader never gets halves of two frames
+atomic_ulong vision_frames = 0;	  // camera frames the vision thread has compared, written only by the vision thread and shown by the control loop
 
 // threshold values
 int avoid_threshold = 1600;	   // the absolute difference between IR readings has to be above this for the avoid action
 int approach_threshold = 1600; // the absolute difference between IR readings has to be below this for the approach action
 int photo_threshold = 200;	   // the absolute difference between photo sensor readings has to be above this for seek light/dark actions
+int motion_threshold = 8;		   // the motion score of one half of the camera image has to be above this for the motion action
+
+// action tuning: motor speeds (between -1 and 1) and durations (seconds) of the actions most often adjusted
+float cruise_speed = 0.08;	   // both motors while cruising straight
+float cruise_time = 0.1;
+float avoid_turn_speed = 0.5;  // the turn away from an obstacle seen by one IR sensor
+float avoid_turn_time = 0.9;
+float seek_turn_speed = 0.2;   // the turn toward the brighter photo sensor
+float seek_turn_time = 0.10;
+float motion_turn_speed = 0.3; // the turn toward (or away from) the side of the camera image that moves the most
+float motion_turn_time = 0.15;
+bool motion_attracts = true;   // true turns toward motion, false turns away from it
 
 // timer
-int timer_duration = 500;	  // the time in milliseconds to wait between calling action commands, changed by each drive command called by actions
-unsigned long start_time = 0; // store the system time each time we start an action so we can see if our time has elapsed without a blocking delay
+int timer_duration = 500;	  // the time in milliseconds the running phase lasts, changed each time a phase of an action starts
+unsigned long start_time = 0; // store the system time each time we start a phase so we can see if our time has elapsed without a blocking delay
+
+// motor command layer
+action_sequence pending_action = {.length = 0}; // the action drive() or run_sequence() collected this tick, only the last one is started
+action_sequence running_action = {.length = 0}; // the action whose phases are being run
+int running_phase = 0;			  // index of the phase of running_action on the servos now
+int last_left_position = -1;	  // the position last written to the left servo, -1 means unknown so the next command is always written
+int last_right_position = -1;	  // the position last written to the right servo
+unsigned long servo_writes = 0;	  // number of set_servo_position calls actually made
+unsigned long suppressed_writes = 0; // number of servo writes skipped because the servo was already at that position
+unsigned long superseded_commands = 0; // number of actions overwritten by a later drive() or run_sequence() in the same tick
+
+// preemption
+bool preemptive_actions = false;   // true lets a behavior ranked above the running action cut it short as soon as it fires, instead of waiting for the action to end
+unsigned int preempting_mask = 0;  // rank bits of the behaviors allowed to cut the running action short, set when the action starts
+unsigned long long outranking_onset = 0; // timestamp of the snapshot in which a behavior able to cut the running action short first fired, 0 if none has
+unsigned long reaction_count = 0;	   // number of reactions to an outranking behavior measured
+unsigned long long total_reaction_time = 0; // summed time (microseconds) from an outranking trigger to the start of the action reacting to it
+unsigned long long max_reaction_time = 0;	// the slowest such reaction (microseconds)
+unsigned long missed_reactions = 0; // outranking triggers that went away again before the running action ended (only possible without preemption)
+
+// logging
+bool use_logger_thread = true; // format and print log events on their own thread so the control loop never waits on the console; false prints them on the spot
+log_event log_queue[LOG_QUEUE_LENGTH]; // events from the control loop to the logger thread
+atomic_ulong log_head = 0;	   // events queued so far, written only by the control loop
+atomic_ulong log_tail = 0;	   // events printed so far, written only by the logger thread
+unsigned long log_drops = 0;   // events thrown away because the queue was full
+
+// telemetry
+bool use_telemetry = true;						 // write a binary record of every operating control tick to telemetry_path
+const char *telemetry_path = "re_telemetry.bin"; // in the program's working directory on the controller
+telemetry_header *telemetry = NULL;				 // the mapped telemetry file, NULL while telemetry is off
+telemetry_record *telemetry_records = NULL;		 // the ring of records following the header
+int tick_winner = TELEMETRY_NO_ARBITRATION;		 // what arbitrate() chose this tick, for the telemetry record
+
+// profiles
+bool use_profiles = true;						// restore the hierarchy and thresholds of profile_name at boot, and save them there whenever the menu changes the hierarchy
+const char *profile_path = "re_profiles.bin";	// in the program's working directory on the controller
+const char *profile_name = NULL;				// the slot to use by name (a new name takes a free slot), NULL resumes the slot used last
+profile_header *profiles = NULL;				// the mapped profile file, NULL while profiles are off
+profile_slot *profile_copies = NULL;			// the PROFILE_COPIES copies of the slot in use
+
+// latency histograms
+bool use_latency_histograms = true; // time every stage of every control tick; false skips the clock reads
+const char *latency_path = NULL;	// append latency reports to this file, NULL prints them to the console
+const char *stage_names[STAGE_COUNT] = {"update_gui", "print_set_hierarchy", "sensors", "arbitration", "commit", "whole tick"};
+latency_histogram latency_histograms[STAGE_COUNT]; // written only by the control loop
+unsigned long long tick_read_nanos = 0; // time arbitration spent reading sensors this tick, moved from the arbitration stage to the sensor stage
+volatile sig_atomic_t latency_report_requested = 0; // set by SIGUSR1, the control loop prints the report at the start of its next tick
+bool latency_combo_held = false; // the A + C combo was down when last looked at, so holding it prints only one report
+
+// control loop scheduler
+int control_rate = 100;			  // how many times per second the control loop senses and arbitrates (Hz, 1 to 1000); the loop sleeps between ticks instead of spinning
+unsigned long next_tick_time = 0; // the system time (ms) at which the next fixed sensing tick is due
+unsigned long tick_count = 0;	  // number of ticks the control loop has run
+unsigned long overrun_count = 0;  // number of ticks that started a whole period or more late (the loop body took too long)
+unsigned long max_jitter = 0;	  // the latest (ms) any tick has woken up after its deadline
+unsigned long total_jitter = 0;	  // sum of all tick lateness (ms), divide by tick_count for the average
 
 // *** Function Definitions *** //
 
@@ -96,15 +285,30 @@ struct behavior subsumption_hierarchy[] = {
 	{"CRUISE STRAIGHT", CRUISE_S_TYPE, 0, true},
 	{"SEEK DARK",  SEEK_DARK_TYPE, 0, false},
 	{"APPROACH", APPROACH_TYPE, 0, false},
-	{"CRUISE ARC", CRUISE_A_TYPE, 0, false}
+	{"CRUISE ARC", CRUISE_A_TYPE, 0, false},
+	{"MOTION", MOTION_TYPE, 0, false}
 };
-int hierarchy_length; //set in main function based on number of elements in subsumption_hierarchy defined above
+int hierarchy_length = sizeof(subsumption_hierarchy) / sizeof(behavior); //number of elements in subsumption_hierarchy defined above
+compiled_behavior dispatch_table[sizeof(subsumption_hierarchy) / sizeof(behavior)]; //only the active behaviors, in rank order, rebuilt by compile_hierarchy() whenever the hierarchy changes
+int dispatch_length = 0; //number of entries in dispatch_table
+unsigned int trigger_rank_table[(BEHAVIOR_TYPE_COUNT + 7) / 8][256]; //for each byte of a trigger mask (one bit per type), the same bits moved to the rank of that type in dispatch_table; rebuilt by compile_hierarchy()
+unsigned char read_plan[SENSOR_GROUP_COUNT]; //the sensor groups the active behaviors need, in the order their highest ranked user appears; rebuilt by compile_hierarchy()
+int read_plan_length = 0; //number of entries in read_plan
+unsigned int unsettled_behaviors[SENSOR_GROUP_COUNT + 1]; //for each step of read_plan, the rank bits of behaviors still waiting on that step or a later one
+atomic_uint required_sensors = ALL_SENSORS; //every group any active behavior needs, all the acquisition and vision threads bother to read
 int cursor_row = 0; //the row that the cursor is on in gui mode
 bool show_gui = true;	//boolean toggled by pushing the white side button on the kipr link
 bool first_gui = false; 	//on first exposure to gui, we randomize the hierarchy so the initialized behavior can't be observed
 bool is_side_update = false;			//sort on button press
 bool update_operating_console = false;	//a boolean to tell us when to update the operating console.  If we constantly reprint and clear, we get flicker, so we only print once when necessary
 
+// retained ui state: what the KIPR ui was last told, so a widget is only pushed again when it changes
+const char *button_texts[BUTTON_COUNT] = {NULL};	//text last set on each button, NULL until it is first set
+int extra_buttons_visible = -1;						//what set_extra_buttons_visible was last called with, -1 until it is first called
+char screen_rows[SCREEN_ROWS][SCREEN_COLUMNS + 1];	//text last written to each console row, empty after the console is cleared
+unsigned long ui_pushes = 0;						//widget updates and rows actually sent to the ui
+unsigned long ui_skips = 0;							//widget updates and rows skipped because nothing changed
+
 //*************************************************** Function Declarations ***********************************************************//
 //=====================================//
 //===============HELPERS===============//
@@ -112,7 +316,47 @@ bool update_operating_console = false;	//a boolean to tell us when to update the
 
 bool timer_elapsed()
 {
-	return (systime() > (start_time + timer_duration)); // return true if the current time is greater than our start time plus timer duration
+	// return true once the last phase of the running action is over: the current time is greater than its start time plus its duration
+	return running_phase + 1 >= running_action.length && (systime() > (start_time + timer_duration));
+}
+/******************************************************/
+unsigned long rate_period(int rate)
+{
+	// length in ms of one cycle at rate Hz, with the rate clamped to 1 to 1000: msleep() and systime() count whole ms, so 1000 Hz is the fastest
+	if (rate < 1) rate = 1;
+	if (rate > 1000) rate = 1000;
+	return 1000 / rate;
+}
+/******************************************************/
+void wait_for_next_tick()
+{
+	unsigned long period = rate_period(control_rate); // length of one sensing tick in ms
+	unsigned long now = systime();
+	unsigned long deadline = next_tick_time;
+	unsigned long action_deadline = start_time + timer_duration + 1; // first time at which timer_elapsed() will return true
+
+	// wake up early if the running action ends before the next sensing tick, so arbitration is not delayed by up to a whole period
+	if (!show_gui && action_deadline > now && action_deadline < deadline){
+		deadline = action_deadline;
+	}
+	if (deadline > now){
+		msleep(deadline - now); // give the processor back to the GUI and anything else running on the controller
+		now = systime();
+	}
+
+	// keep track of how late we woke up compared to when we wanted to
+	unsigned long jitter = (now > deadline) ? now - deadline : 0;
+	total_jitter += jitter;
+	if (jitter > max_jitter) max_jitter = jitter;
+	tick_count++;
+
+	if (now >= next_tick_time + period){
+		overrun_count++;			 // we missed at least one whole tick, so start counting again from now instead of running a burst of late ticks
+		next_tick_time = now + period;
+	}
+	else if (now >= next_tick_time){
+		next_tick_time += period;	 // stay on the fixed grid of ticks so the rate doesn't drift
+	}
 }
 /******************************************************/
 float map(float value, float start_range_low, float start_range_high, float target_range_low, float target_range_high)
@@ -120,47 +364,301 @@ float map(float value, float start_range_low, float start_range_high, float targ
 	return target_range_low + ((value - start_range_low) / (start_range_high - start_range_low)) * (target_range_high - target_range_low);
 	// remap a value from a source range to a new range
 }
+/******************************************************/
+unsigned long long stage_clock()
+{
+	// nanoseconds on the monotonic clock for the latency histograms, or 0 without them so the clock is never read
+	if (!use_latency_histograms) return 0;
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (unsigned long long)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+/******************************************************/
+void log_values(const char *format, int a, int b, int c)
+{
+	// queue a diagnostic for the logger thread instead of printing it here.  Only the control loop may call this; it never blocks, a full queue drops the event
+	if (!use_logger_thread){
+		printf(format, a, b, c);
+		return;
+	}
+	unsigned long head = atomic_load_explicit(&log_head, memory_order_relaxed);
+	if (head - atomic_load_explicit(&log_tail, memory_order_acquire) >= LOG_QUEUE_LENGTH){
+		log_drops++;
+		return;
+	}
+	log_event *event = &log_queue[head % LOG_QUEUE_LENGTH];
+	event->format = format;
+	event->values[0] = a;
+	event->values[1] = b;
+	event->values[2] = c;
+	atomic_store_explicit(&log_head, head + 1, memory_order_release); // the logger sees the event only once it is complete
+}
+/******************************************************/
+void write_log()
+{
+	// body of the logger thread: format and print queued events, then sleep a little once the queue is empty
+	while (true){
+		unsigned long tail = atomic_load_explicit(&log_tail, memory_order_relaxed);
+		unsigned long head = atomic_load_explicit(&log_head, memory_order_acquire);
+		if (tail == head){
+			msleep(20);
+			continue;
+		}
+		while (tail != head){
+			log_event event = log_queue[tail % LOG_QUEUE_LENGTH];
+			atomic_store_explicit(&log_tail, ++tail, memory_order_release); // hand the slot back before the slow part
+			printf(event.format, event.values[0], event.values[1], event.values[2]);
+		}
+		fflush(stdout);
+	}
+}
+/******************************************************/
+void start_logger_thread()
+{
+	thread logger = thread_create(write_log);
+	thread_start(logger);
+}
 
 //========================================//
 //===============PERCEPTION===============//
 //========================================//
 
-void read_sensors()
+unsigned long long monotonic_micros()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now); // unlike systime() this never jumps if the wall clock is changed
+	return (unsigned long long)now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+}
+/******************************************************/
+void read_sensor_groups(sensor_snapshot *snapshot, unsigned char groups)
+{
+	// read the pins of each requested sensor group that this snapshot doesn't already hold
+	groups &= ~snapshot->sensors_read;
+	unsigned long reads = 0;
+	if (groups & PHOTO_SENSORS){
+		snapshot->right_photo = analog(RIGHT_PHOTO_PIN); // read the photo sensor at RIGHT_PHOTO_PIN; *** NOTE: greater value means less light ***
+		snapshot->left_photo = analog(LEFT_PHOTO_PIN);	 // read the photo sensor at LEFT_PHOTO_PIN
+		reads += 2;
+	}
+	if (groups & IR_SENSORS){
+		snapshot->right_ir = analog(RIGHT_IR_PIN); // read the IR sensor at RIGHT_IR_PIN
+		snapshot->left_ir = analog(LEFT_IR_PIN);   // read the IR sensor at LEFT_IR_PIN
+		reads += 2;
+	}
+	// read the bumpers, a bumper reads 0 while it is pressed
+	if (groups & FRONT_BUMP_SENSORS){
+		unsigned char bumps = snapshot->bumps & ~FRONT_BUMP_BITS;
+		if (digital(FRONT_BUMP_LEFT_PIN) == 0) bumps |= FRONT_BUMP_LEFT_BIT;
+		if (digital(FRONT_BUMP_CENTER_PIN) == 0) bumps |= FRONT_BUMP_CENTER_BIT;
+		if (digital(FRONT_BUMP_RIGHT_PIN) == 0) bumps |= FRONT_BUMP_RIGHT_BIT;
+		snapshot->bumps = bumps;
+		reads += 3;
+	}
+	if (groups & BACK_BUMP_SENSORS){
+		unsigned char bumps = snapshot->bumps & ~BACK_BUMP_BITS;
+		if (digital(BACK_BUMP_LEFT_PIN) == 0) bumps |= BACK_BUMP_LEFT_BIT;
+		if (digital(BACK_BUMP_CENTER_PIN) == 0) bumps |= BACK_BUMP_CENTER_BIT;
+		if (digital(BACK_BUMP_RIGHT_PIN) == 0) bumps |= BACK_BUMP_RIGHT_BIT;
+		snapshot->bumps = bumps;
+		reads += 3;
+	}
+	if (groups & VISION_SENSORS){
+		unsigned int scores = atomic_load_explicit(&motion_scores, memory_order_relaxed); // whatever the vision thread published last, never a wait for a frame
+		snapshot->left_motion = scores >> 16;
+		snapshot->right_motion = scores & 0xFFFF;
+	}
+	snapshot->sensors_read |= groups;
+	if (reads) atomic_fetch_add_explicit(&pin_reads, reads, memory_order_relaxed); // one add per snapshot, not per pin
+}
+/******************************************************/
+void copy_snapshot_words(sensor_snapshot *to, const sensor_snapshot *from)
+{
+	// copy a snapshot one word at a time with relaxed atomic loads and stores, so a reader copying a slot while the writer refills it
+	// is not a data race; whether the copy came out whole is up to the sensor_claimed check in sensor_history_at()
+	snapshot_word *to_words = (snapshot_word *)to;
+	const snapshot_word *from_words = (const snapshot_word *)from;
+	size_t i;
+	for (i = 0; i < sizeof(sensor_snapshot) / sizeof(snapshot_word); i++){
+		__atomic_store_n(&to_words[i], __atomic_load_n(&from_words[i], __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+	}
+}
+/******************************************************/
+sensor_snapshot *claim_snapshot()
 {
-	right_photo_value = analog(RIGHT_PHOTO_PIN);			// read the photo sensor at RIGHT_PHOTO_PIN; *** NOTE: greater value means less light ***
-	left_photo_value = analog(LEFT_PHOTO_PIN);			// read the photo sensor at LEFT_PHOTO_PIN; *** NOTE: greater value means less light ***
-	right_ir_value = analog(RIGHT_IR_PIN);				// read the IR sensor at RIGHT_IR_PIN
-	left_ir_value = analog(LEFT_IR_PIN);					// read the IR sensor at LEFT_IR_PIN
-	// read the bumpers
-	front_bump_left_value = digital(FRONT_BUMP_LEFT_PIN);   // read the bumper at FRONT_BUMP_LEFT_PIN
-	front_bump_center_value = digital(FRONT_BUMP_CENTER_PIN); // read the bumper at FRONT_BUMP_CENTER_PIN
-	front_bump_right_value = digital(FRONT_BUMP_RIGHT_PIN);  // read the bumper at FRONT_BUMP_RIGHT_PIN
-	back_bump_left_value = digital(BACK_BUMP_LEFT_PIN);	// read the bumper at BACK_BUMP_LEFT_PIN
-	back_bump_center_value = digital(BACK_BUMP_CENTER_PIN);  // read the bumper at BACK_BUMP_CENTER_PIN
-	back_bump_right_value = digital(BACK_BUMP_RIGHT_PIN);	// read the bumper at BACK_BUMP_RIGHT_PIN	
+	// claim the next slot of the history ring.  Only one thread may write snapshots
+	unsigned long count = atomic_load_explicit(&sensor_count, memory_order_relaxed);
+	atomic_store_explicit(&sensor_claimed, count + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release); // readers that see any of the new slot contents will also see the claim
+	return &sensor_history[count % SENSOR_HISTORY_LENGTH];
 }
 /******************************************************/
-bool is_above_photo_differential(int threshold)
+sensor_snapshot *begin_snapshot()
 {
-	int photo_difference = abs(right_photo_value - left_photo_value); // get the difference between the photo values
-	return photo_difference > threshold;							  // returns true if the absolute difference between photo sensors is greater than the threshold, otherwise false
+	// claim the next slot of the history ring for a new, still empty snapshot the control loop reads into in place, only without the acquisition thread
+	sensor_snapshot *snapshot = claim_snapshot();
+	snapshot->sensors_read = 0;
+	snapshot->timestamp = monotonic_micros();
+	return snapshot;
+}
+/******************************************************/
+void end_snapshot()
+{
+	// publish the snapshot claimed by begin_snapshot() or claim_snapshot()
+	unsigned long count = atomic_load_explicit(&sensor_count, memory_order_relaxed);
+	atomic_store_explicit(&sensor_count, count + 1, memory_order_release); // readers that see the new count will also see the whole snapshot
+}
+/******************************************************/
+void publish_snapshot(unsigned char groups)
+{
+	// read the requested sensor groups into a snapshot of our own, then copy it into the next slot of the history ring and publish it.
+	// Readers may be copying that slot at the same time, so it is only ever written word by word
+	sensor_snapshot snapshot = {0};
+	snapshot.timestamp = monotonic_micros();
+	read_sensor_groups(&snapshot, groups);
+	copy_snapshot_words(claim_snapshot(), &snapshot);
+	end_snapshot();
+}
+/******************************************************/
+bool sensor_history_at(unsigned long age, sensor_snapshot *snapshot)
+{
+	// copy a snapshot out of the history ring without ever waiting on the writer.  Age 0 is the newest snapshot, 1 the one before it, and so on.
+	// returns false if that snapshot was never taken or has already been overwritten
+	while (true){
+		unsigned long count = atomic_load_explicit(&sensor_count, memory_order_acquire);
+		if (age >= count || age >= SENSOR_HISTORY_LENGTH) return false;
+		unsigned long index = count - 1 - age;
+		copy_snapshot_words(snapshot, &sensor_history[index % SENSOR_HISTORY_LENGTH]);
+		atomic_thread_fence(memory_order_acquire);
+		unsigned long claimed = atomic_load_explicit(&sensor_claimed, memory_order_relaxed);
+		if (claimed <= index + SENSOR_HISTORY_LENGTH) return true; // the writer hasn't started reusing our slot, so the copy is whole
+		// otherwise the writer lapped us mid-copy, try again with the new count
+	}
 }
 /******************************************************/
-bool is_above_distance_threshold(int threshold)
+bool latest_snapshot(sensor_snapshot *snapshot)
 {
-	return (left_ir_value > threshold || right_ir_value > threshold) && !(left_ir_value > threshold && right_ir_value > threshold);
+	return sensor_history_at(0, snapshot); // the freshest sample, never blocks on ADC I/O
+}
+/******************************************************/
+void acquire_sensors()
+{
+	// body of the acquisition thread: sample the pins the active hierarchy needs at a fixed rate for as long as the program runs
+	while (true){
+		publish_snapshot(atomic_load_explicit(&required_sensors, memory_order_relaxed));
+		msleep(rate_period(sensor_rate));
+	}
+}
+/******************************************************/
+void start_sensor_thread()
+{
+	publish_snapshot(ALL_SENSORS); // make sure a snapshot exists before the control loop first asks for one
+	thread acquisition = thread_create(acquire_sensors);
+	thread_start(acquisition);
+}
+/******************************************************/
+void shrink_frame(const unsigned char *frame, int width, int height, unsigned char *grid)
+{
+	// average the brightness of every pixel of a BGR camera frame into MOTION_GRID_COLUMNS x MOTION_GRID_ROWS cells, so noise in single pixels averages out
+	// and comparing two frames touches a couple of hundred cells instead of every pixel
+	int row, column, x, y;
+	for (row = 0; row < MOTION_GRID_ROWS; row++){
+		int top = height * row / MOTION_GRID_ROWS, bottom = height * (row + 1) / MOTION_GRID_ROWS;
+		for (column = 0; column < MOTION_GRID_COLUMNS; column++){
+			int left = width * column / MOTION_GRID_COLUMNS, right = width * (column + 1) / MOTION_GRID_COLUMNS;
+			unsigned long sum = 0;
+			for (y = top; y < bottom; y++){
+				const unsigned char *pixel = frame + 3 * ((size_t)y * width + left);
+				for (x = left; x < right; x++, pixel += 3) sum += pixel[0] + 2 * pixel[1] + pixel[2]; // blue, green, red; green counts twice, as it does for the eye
+			}
+			grid[row * MOTION_GRID_COLUMNS + column] = sum / (4 * (unsigned long)(bottom - top) * (right - left));
+		}
+	}
+}
+/******************************************************/
+void publish_motion(const unsigned char *grid, const unsigned char *previous)
+{
+	// the average change of the cells in each half of the grid, published as one word
+	unsigned int left_change = 0, right_change = 0;
+	int cell;
+	for (cell = 0; cell < MOTION_GRID_ROWS * MOTION_GRID_COLUMNS; cell++){
+		unsigned int change = abs(grid[cell] - previous[cell]);
+		if (cell % MOTION_GRID_COLUMNS < MOTION_GRID_COLUMNS / 2) left_change += change;
+		else right_change += change;
+	}
+	unsigned int half = MOTION_GRID_ROWS * MOTION_GRID_COLUMNS / 2;
+	atomic_store_explicit(&motion_scores, (left_change / half) << 16 | (right_change / half), memory_order_relaxed);
+}
+/******************************************************/
+void watch_motion()
+{
+	// body of the vision thread: compare each camera frame with the one before on the coarse grid and publish the motion on either side.
+	// camera_update() waits for the next frame here, so the control loop only ever reads the latest scores.  Rests while no active behavior needs them
+	unsigned char grid[MOTION_GRID_ROWS * MOTION_GRID_COLUMNS], previous[MOTION_GRID_ROWS * MOTION_GRID_COLUMNS];
+	bool have_previous = false;
+	while (true){
+		if (!(atomic_load_explicit(&required_sensors, memory_order_relaxed) & VISION_SENSORS)){
+			atomic_store_explicit(&motion_scores, 0, memory_order_relaxed);
+			have_previous = false; // the next frame could be from anywhere
+			msleep(100);
+			continue;
+		}
+		const unsigned char *frame = camera_update() ? get_camera_frame() : NULL;
+		int width = get_camera_width(), height = get_camera_height();
+		if (frame == NULL || width < MOTION_GRID_COLUMNS || height < MOTION_GRID_ROWS){
+			atomic_store_explicit(&motion_scores, 0, memory_order_relaxed); // no frame, no motion seen
+			have_previous = false;
+			msleep(20);
+			continue;
+		}
+		shrink_frame(frame, width, height, grid);
+		if (have_previous) publish_motion(grid, previous);
+		memcpy(previous, grid, sizeof(grid));
+		have_previous = true;
+		atomic_fetch_add_explicit(&vision_frames, 1, memory_order_relaxed);
+	}
+}
+/******************************************************/
+void start_vision_thread()
+{
+	// open the camera the first time the active hierarchy needs the motion scores, so a robot that never activates MOTION never turns it on.
+	// Once started the thread stays, resting whenever MOTION is deactivated again
+	if (vision_started || !(atomic_load_explicit(&required_sensors, memory_order_relaxed) & VISION_SENSORS)) return;
+	if (!camera_open()){
+		printf("vision off, could not open the camera\n");
+		use_vision = false;
+		return;
+	}
+	thread vision = thread_create(watch_motion);
+	thread_start(vision);
+	vision_started = true;
+}
+/******************************************************/
+bool is_above_photo_differential(const sensor_snapshot *sensors, int threshold)
+{
+	int photo_difference = abs(sensors->right_photo - sensors->left_photo); // get the difference between the photo values
+	return photo_difference > threshold;									 // returns true if the absolute difference between photo sensors is greater than the threshold, otherwise false
+}
+/******************************************************/
+bool is_above_distance_threshold(const sensor_snapshot *sensors, int threshold)
+{
+	return (sensors->left_ir > threshold || sensors->right_ir > threshold) && !(sensors->left_ir > threshold && sensors->right_ir > threshold);
 	// returns true if one (exclusive) IR value is above the threshold, otherwise false
 }
 
 /******************************************************/
-bool is_front_bump()
+bool is_above_motion_threshold(const sensor_snapshot *sensors, int threshold)
+{
+	return sensors->left_motion > threshold || sensors->right_motion > threshold; // returns true if either half of the camera image changed more than the threshold, otherwise false
+}
+/******************************************************/
+bool is_front_bump(const sensor_snapshot *sensors)
 {
-	return (front_bump_left_value == 0 || front_bump_right_value == 0); // return true if one of the front bump values is 1, otherwise false
+	return (sensors->bumps & (FRONT_BUMP_LEFT_BIT | FRONT_BUMP_RIGHT_BIT)) != 0; // return true if the left or right front bumper is pressed, otherwise false
 }
 /******************************************************/
-bool is_back_bump()
+bool is_back_bump(const sensor_snapshot *sensors)
 {
-	return (back_bump_left_value == 0 || back_bump_center_value == 0 || back_bump_right_value == 0); // return true if one of the back bump values is 1, otherwise false
+	return (sensors->bumps & (BACK_BUMP_LEFT_BIT | BACK_BUMP_CENTER_BIT | BACK_BUMP_RIGHT_BIT)) != 0; // return true if one of the back bumpers is pressed, otherwise false
 }
 /******************************************************/
 
@@ -169,27 +667,85 @@ bool is_back_bump()
 //====================================//
 
 /******************************************************/
-void drive(float left, float right, float delay_seconds)
+motor_command make_motor_command(float left, float right, float delay_seconds)
 {
 	// 850 is full motor speed clockwise, 1250 is full motor speed counterclockwise
 	// Servo is stopped from ~1044 to 1055
+	motor_command command;
+	command.left_position = (int)map(left, -1.0, 1.0, 0, 2047); // call the map function to map our speed (set between -1 and 1) to the appropriate range of motor values
+	command.right_position = (int)map(right, -1.0, 1.0, 2047, 0);
+	command.duration = (int)(delay_seconds * 1000.0); // multiply our desired time in seconds by 1000 to get milliseconds
+	return command;
+}
+/******************************************************/
+void run_sequence(const motor_phase *phases, int length)
+{
+	// queue an action made of several timed phases.  The control loop starts it at the end of this tick and moves on to each next phase as the last one ends,
+	// sensing the whole time instead of blocking
+	if (pending_action.length > 0) superseded_commands++; // an earlier action this tick never reaches the servos
+	if (length > MAX_ACTION_PHASES) length = MAX_ACTION_PHASES;
+	int i;
+	for (i = 0; i < length; i++){
+		pending_action.phases[i] = make_motor_command(phases[i].left, phases[i].right, phases[i].seconds);
+	}
+	pending_action.length = length;
+}
+/******************************************************/
+void drive(float left, float right, float delay_seconds)
+{
+	motor_phase phase = {left, right, delay_seconds};
+	run_sequence(&phase, 1); // a plain drive is an action with a single phase
+}
+/******************************************************/
+void start_phase(int phase)
+{
+	const motor_command *command = &running_action.phases[phase];
+	running_phase = phase;
+	timer_duration = command->duration; // update the global timer so timer_elapsed() and the scheduler know when this phase ends
+	start_time = systime();				// update our start time to reflect the time we start driving (in ms)
 
-	float left_speed = map(left, -1.0, 1.0, 0, 2047); // call the map function to map our speed (set between -1 and 1) to the appropriate range of motor values
-	float right_speed = map(right, -1.0, 1.0, 2047, 0);
-
-	timer_duration = (int)(delay_seconds * 1000.0); // multiply our desired time in seconds by 1000 to get milliseconds and update this global variable
-	start_time = systime();							// update our start time to reflect the time we start driving (in ms)
-
-	set_servo_position(LEFT_MOTOR_PIN, left_speed);
-	set_servo_position(RIGHT_MOTOR_PIN, right_speed); // set the servos to run at the mapped speed
+	// only talk to a servo if its position actually changes
+	if (command->left_position != last_left_position){
+		set_servo_position(LEFT_MOTOR_PIN, command->left_position);
+		last_left_position = command->left_position;
+		servo_writes++;
+	}
+	else suppressed_writes++;
+	if (command->right_position != last_right_position){
+		set_servo_position(RIGHT_MOTOR_PIN, command->right_position);
+		last_right_position = command->right_position;
+		servo_writes++;
+	}
+	else suppressed_writes++;
+}
+/******************************************************/
+void commit_motor_command()
+{
+	// called once at the end of every tick: start the action collected this tick, or step the running action on to its next phase when the current one is over
+	if (pending_action.length > 0){
+		running_action = pending_action;
+		pending_action.length = 0;
+		start_phase(0);
+	}
+	else if (running_phase + 1 < running_action.length && systime() > start_time + timer_duration){
+		start_phase(running_phase + 1);
+	}
 }
 /******************************************************/
-void cruise_straight()
+void enable_motors()
 {
-	drive(0.08, 0.08, 0.1);
+	enable_servo(LEFT_MOTOR_PIN);
+	enable_servo(RIGHT_MOTOR_PIN);
+	last_left_position = -1; // we don't know where the servos are after being re-enabled, so the next command must be written
+	last_right_position = -1;
 }
 /******************************************************/
-void cruise_arc()
+void cruise_straight(const sensor_snapshot *sensors)
+{
+	drive(cruise_speed, cruise_speed, cruise_time);
+}
+/******************************************************/
+void cruise_arc(const sensor_snapshot *sensors)
 {
 	drive(0.25, 0.4, 0.5);
 }
@@ -199,44 +755,47 @@ void stop()
 	drive(0.0, 0.0, 0.25);
 }
 /******************************************************/
-void escape_front()
+void escape_front(const sensor_snapshot *sensors)
 {
 	
-    if(front_bump_left_value == 0)
+    if(sensors->bumps & FRONT_BUMP_LEFT_BIT)
     {
         drive(-0.1, -1, 2); //drive backwards in an arc
     }
-    else if(front_bump_right_value == 0)
+    else if(sensors->bumps & FRONT_BUMP_RIGHT_BIT)
     {
         drive(-1, -0.1, 2); //drive backwards in an arc
     }
 }
 /******************************************************/
-void escape_back()
+const motor_phase escape_back_phases[] = {
+	{0.0, 0.0, 0.5},  //pause for a moment
+	{0.5, 0.5, 0.25}  //then drive forward a little
+};
+void escape_back(const sensor_snapshot *sensors)
 {
-	drive(0.0, 0.0, 0.5); //drive forward a little
-    drive(0.5, 0.5, 0.25); //drive forward a little
+	run_sequence(escape_back_phases, sizeof(escape_back_phases) / sizeof(motor_phase));
 }
 /******************************************************/
-void seek_light()
+void seek_light(const sensor_snapshot *sensors)
 {
 	// greater photo_value means less light
-	int photo_difference = right_photo_value - left_photo_value;
-    printf("right_photo_value: %d, left_photo_value: %d, photo_difference: %d\n", right_photo_value, left_photo_value, photo_difference);
+	int photo_difference = sensors->right_photo - sensors->left_photo;
+	LOG_VALUES("right_photo_value: %d, left_photo_value: %d, photo_difference: %d\n", sensors->right_photo, sensors->left_photo, photo_difference);
 	// positive photo_difference means left sensor is brighter
 	if (photo_difference > 0){
-		drive(-0.2, 0.2, 0.10);
+		drive(-seek_turn_speed, seek_turn_speed, seek_turn_time);
 	}
 	// negative photo_difference means right sensor is brighter
 	if (photo_difference < 0){
-		drive(0.2, -0.2, 0.10);
+		drive(seek_turn_speed, -seek_turn_speed, seek_turn_time);
 	}
 }
 /******************************************************/
-void seek_dark()
+void seek_dark(const sensor_snapshot *sensors)
 {
 	// greater photo_value means less light
-	int photo_difference = right_photo_value - left_photo_value;
+	int photo_difference = sensors->right_photo - sensors->left_photo;
 	// positive photo_difference means left sensor is brighter
 	if (photo_difference > 0){
 		drive(-0.2, 0.2, 0.25);
@@ -247,31 +806,595 @@ void seek_dark()
 	}
 }
 /******************************************************/
-void avoid()
+void avoid(const sensor_snapshot *sensors)
 {
-	if (left_ir_value > avoid_threshold)
+	if (sensors->left_ir > avoid_threshold)
 	{
-		drive(0.5, -0.5, 0.9);
+		drive(avoid_turn_speed, -avoid_turn_speed, avoid_turn_time);
 	}
 
-	else if (right_ir_value > avoid_threshold)
+	else if (sensors->right_ir > avoid_threshold)
 	{
-		drive(-0.5, 0.5, 0.9);
+		drive(-avoid_turn_speed, avoid_turn_speed, avoid_turn_time);
 	}
 }
 /******************************************************/
-void approach()
+void approach(const sensor_snapshot *sensors)
 {
-	if (left_ir_value > approach_threshold)
+	if (sensors->left_ir > approach_threshold)
 	{
 		drive(0.1, 0.9, 0.5);
 	}
-	else if (right_ir_value > approach_threshold)
+	else if (sensors->right_ir > approach_threshold)
 	{
 		drive(0.9, 0.1, 0.5);
 	}
 }
 /******************************************************/
+void follow_motion(const sensor_snapshot *sensors)
+{
+	// positive motion_difference means more is moving on the left half of the image, which is the robot's left with the camera facing forward
+	int motion_difference = sensors->left_motion - sensors->right_motion;
+	LOG_VALUES("left_motion: %d, right_motion: %d, motion_difference: %d\n", sensors->left_motion, sensors->right_motion, motion_difference);
+	if (motion_difference == 0) return;
+	if ((motion_difference > 0) == motion_attracts){
+		drive(-motion_turn_speed, motion_turn_speed, motion_turn_time); // turn left
+	}
+	else{
+		drive(motion_turn_speed, -motion_turn_speed, motion_turn_time); // turn right
+	}
+}
+/******************************************************/
+/******************************************************/
+
+//=========================================//
+//===============ARBITRATION===============//
+//=========================================//
+
+// the sensor groups each behavior type's predicate and action read, indexed by type key
+const unsigned char behavior_sensors[BEHAVIOR_TYPE_COUNT] = {
+	[SEEK_LIGHT_TYPE] = PHOTO_SENSORS,
+	[SEEK_DARK_TYPE] = PHOTO_SENSORS,
+	[APPROACH_TYPE] = IR_SENSORS,
+	[AVOID_TYPE] = IR_SENSORS,
+	[ESCAPE_F_TYPE] = FRONT_BUMP_SENSORS,
+	[ESCAPE_B_TYPE] = BACK_BUMP_SENSORS,
+	[CRUISE_S_TYPE] = 0, // cruising doesn't look at anything
+	[CRUISE_A_TYPE] = 0,
+	[MOTION_TYPE] = VISION_SENSORS
+};
+// the action run by each behavior type, indexed by type key
+void (*behavior_actions[BEHAVIOR_TYPE_COUNT])(const sensor_snapshot *sensors) = {
+	[SEEK_LIGHT_TYPE] = seek_light,
+	[SEEK_DARK_TYPE] = seek_dark,
+	[APPROACH_TYPE] = approach,
+	[AVOID_TYPE] = avoid,
+	[ESCAPE_F_TYPE] = escape_front,
+	[ESCAPE_B_TYPE] = escape_back,
+	[CRUISE_S_TYPE] = cruise_straight,
+	[CRUISE_A_TYPE] = cruise_arc,
+	[MOTION_TYPE] = follow_motion
+};
+/******************************************************/
+void compile_hierarchy()
+{
+	// walk the hierarchy once and keep only what the control loop needs: the active behaviors in rank order
+	unsigned int rank_bit[BEHAVIOR_TYPE_COUNT] = {0}; // the bit each active type occupies in a rank ordered mask, zero for inactive types
+	dispatch_length = 0;
+	size_t i;
+	for (i = 0; i < hierarchy_length; i++){
+		if (!subsumption_hierarchy[i].is_active) continue;
+		int type = subsumption_hierarchy[i].type;
+		rank_bit[type] = 1u << dispatch_length;
+		dispatch_table[dispatch_length].type = type;
+		dispatch_table[dispatch_length].action = behavior_actions[type];
+		dispatch_length++;
+	}
+
+	// precompute the type order -> rank order bit shuffle one byte (eight types) at a time, so the control loop does one lookup per eight types instead of a loop per behavior
+	int chunk, value, bit;
+	for (chunk = 0; chunk < (BEHAVIOR_TYPE_COUNT + 7) / 8; chunk++){
+		for (value = 0; value < 256; value++){
+			unsigned int ranked = 0;
+			for (bit = 0; bit < 8 && chunk * 8 + bit < BEHAVIOR_TYPE_COUNT; bit++){
+				if (value & (1 << bit)) ranked |= rank_bit[chunk * 8 + bit];
+			}
+			trigger_rank_table[chunk][value] = ranked;
+		}
+	}
+
+	// plan the order sensor groups are read in: a group is read just before the highest ranked behavior that needs it
+	unsigned char planned = 0;
+	read_plan_length = 0;
+	for (i = 0; i < dispatch_length; i++){
+		unsigned char needed = behavior_sensors[dispatch_table[i].type] & ~planned;
+		if (needed){
+			read_plan[read_plan_length++] = needed;
+			planned |= needed;
+		}
+	}
+	int step;
+	for (step = 0; step <= read_plan_length; step++){
+		unsigned char unread = 0; // the groups still to be read from this step on
+		int later;
+		for (later = step; later < read_plan_length; later++) unread |= read_plan[later];
+		unsettled_behaviors[step] = 0;
+		for (i = 0; i < dispatch_length; i++){
+			if (behavior_sensors[dispatch_table[i].type] & unread) unsettled_behaviors[step] |= 1u << i;
+		}
+	}
+	atomic_store_explicit(&required_sensors, planned, memory_order_relaxed); // the acquisition thread stops reading groups nobody uses
+}
+/******************************************************/
+unsigned int evaluate_triggers(const sensor_snapshot *sensors, unsigned char groups)
+{
+	// one pass over a snapshot that works out every trigger condition depending on the given sensor groups, one bit per behavior type
+	unsigned int triggers = (1u << CRUISE_S_TYPE) | (1u << CRUISE_A_TYPE); // cruise behaviors fire whenever nothing above them does
+	groups &= sensors->sensors_read; // a group that wasn't read can't fire anything
+
+	if ((groups & PHOTO_SENSORS) && is_above_photo_differential(sensors, photo_threshold)){
+		triggers |= (1u << SEEK_LIGHT_TYPE) | (1u << SEEK_DARK_TYPE); // seek light and seek dark share the photo differential
+	}
+	if (groups & IR_SENSORS){
+		bool avoid_distance = is_above_distance_threshold(sensors, avoid_threshold);
+		bool approach_distance = (approach_threshold == avoid_threshold) ? avoid_distance : is_above_distance_threshold(sensors, approach_threshold); // only check the IRs a second time if the thresholds differ
+		if (avoid_distance) triggers |= 1u << AVOID_TYPE;
+		if (approach_distance) triggers |= 1u << APPROACH_TYPE;
+	}
+	if ((groups & FRONT_BUMP_SENSORS) && is_front_bump(sensors)) triggers |= 1u << ESCAPE_F_TYPE;
+	if ((groups & BACK_BUMP_SENSORS) && is_back_bump(sensors)) triggers |= 1u << ESCAPE_B_TYPE;
+	if ((groups & VISION_SENSORS) && is_above_motion_threshold(sensors, motion_threshold)) triggers |= 1u << MOTION_TYPE;
+	return triggers;
+}
+/******************************************************/
+unsigned int rank_triggers(unsigned int triggers)
+{
+	// move each trigger bit from its type position to its rank position; inactive types drop out.  Bit 0 of the result is the top of the hierarchy
+	unsigned int ranked = 0;
+	int chunk;
+	for (chunk = 0; chunk < (BEHAVIOR_TYPE_COUNT + 7) / 8; chunk++){
+		ranked |= trigger_rank_table[chunk][(triggers >> (chunk * 8)) & 0xFF];
+	}
+	return ranked;
+}
+/******************************************************/
+int select_behavior(sensor_snapshot *sensors, bool can_read, unsigned int candidates)
+{
+	// find the highest ranked behavior among the candidates (rank bits) that fires.  With can_read, sensor groups missing from the snapshot are read in read_plan order,
+	// stopping as soon as a candidate has fired that no candidate still unread could outrank.  Returns its index in dispatch_table, or -1 if none fires
+	unsigned int triggers = evaluate_triggers(sensors, sensors->sensors_read);
+	int step;
+	for (step = 0; ; step++){
+		unsigned int pending = unsettled_behaviors[step] & candidates;
+		unsigned int ranked = rank_triggers(triggers) & candidates & ~pending; // only behaviors whose sensors are all in hand can win
+		if (ranked != 0 && (pending == 0 || __builtin_ctz(ranked) < __builtin_ctz(pending))){
+			return __builtin_ctz(ranked); // the lowest set bit is the highest ranked behavior that fired
+		}
+		if (pending == 0 || step == read_plan_length) return -1; // no candidate left that could still fire
+		unsigned char group = read_plan[step];
+		if (can_read && !(sensors->sensors_read & group)){
+			unsigned long long read_begin = stage_clock();
+			read_sensor_groups(sensors, group);
+			if (use_latency_histograms) tick_read_nanos += stage_clock() - read_begin;
+			triggers |= evaluate_triggers(sensors, group);
+		}
+	}
+}
+/******************************************************/
+void arbitrate(sensor_snapshot *sensors, bool can_read)
+{
+	int winner = select_behavior(sensors, can_read, ~0u);
+
+	// if something outranking the previous action fired while it ran, this is the reaction to it, so record how long it took
+	if (outranking_onset != 0){
+		unsigned long long reaction_time = monotonic_micros() - outranking_onset;
+		reaction_count++;
+		total_reaction_time += reaction_time;
+		if (reaction_time > max_reaction_time) max_reaction_time = reaction_time;
+		outranking_onset = 0;
+	}
+
+	if (winner < 0){
+		stop(); // no active behavior fired (or nothing is active), so stand still
+		preempting_mask = ~0u; // anything that fires may end the stop early
+		tick_winner = TELEMETRY_STOPPED;
+		return;
+	}
+	dispatch_table[winner].action(sensors);
+	tick_winner = dispatch_table[winner].type;
+	preempting_mask = (1u << winner) - 1; // only behaviors ranked above the winner may cut it short
+}
+/******************************************************/
+void check_preemption(sensor_snapshot *sensors, bool can_read)
+{
+	// called every tick while an action is running.  Looks only at behaviors ranked above the running one, and only reads their sensors
+	if (preempting_mask == 0) return; // nothing can outrank this action (e.g. the pause after leaving the menu)
+	int winner = select_behavior(sensors, can_read, preempting_mask);
+	if (winner < 0){
+		if (outranking_onset != 0){
+			missed_reactions++; // it fired and went away again while we were busy, so we never reacted to it
+			outranking_onset = 0;
+		}
+		return;
+	}
+	if (outranking_onset == 0) outranking_onset = sensors->timestamp;
+	if (preemptive_actions) arbitrate(sensors, can_read); // cut the running action short; the new action starts at the end of this tick
+}
+/******************************************************/
+#ifdef DISPATCH_BENCHMARK
+// compile with -DDISPATCH_BENCHMARK to compare how many arbitration ticks per second the old per-tick switch walk and the bitmask arbitration manage.
+// only the winner is selected, no action is run, so the servos are never touched while measuring.
+int select_with_switch(const sensor_snapshot *sensors)
+{
+	size_t i;
+	for (i = 0; i < hierarchy_length; i++){
+		if (!subsumption_hierarchy[i].is_active) continue;
+		bool fire = false;
+		switch (subsumption_hierarchy[i].type){
+			case SEEK_LIGHT_TYPE:
+			case SEEK_DARK_TYPE:
+			fire = is_above_photo_differential(sensors, photo_threshold);
+			break;
+			case APPROACH_TYPE:
+			fire = is_above_distance_threshold(sensors, approach_threshold);
+			break;
+			case AVOID_TYPE:
+			fire = is_above_distance_threshold(sensors, avoid_threshold);
+			break;
+			case ESCAPE_F_TYPE:
+			fire = is_front_bump(sensors);
+			break;
+			case ESCAPE_B_TYPE:
+			fire = is_back_bump(sensors);
+			break;
+			case MOTION_TYPE:
+			fire = is_above_motion_threshold(sensors, motion_threshold);
+			break;
+			case CRUISE_S_TYPE:
+			case CRUISE_A_TYPE:
+			fire = true;
+			break;
+		}
+		if (fire) return i;
+	}
+	return -1;
+}
+/******************************************************/
+int select_with_mask(sensor_snapshot *sensors)
+{
+	return select_behavior(sensors, false, ~0u);
+}
+/******************************************************/
+void benchmark_dispatch(long iterations)
+{
+	volatile int winner; // volatile so the compiler can't throw the selection away
+	long n;
+
+	sensor_snapshot snapshot = {0};
+	sensor_snapshot *sensors = &snapshot;
+	read_sensor_groups(sensors, ALL_SENSORS); // both selections get every sensor, the switch walk has no idea which ones it needs
+	unsigned long begin = systime();
+	for (n = 0; n < iterations; n++) winner = select_with_switch(sensors);
+	unsigned long switch_ms = systime() - begin;
+
+	begin = systime();
+	for (n = 0; n < iterations; n++) winner = select_with_mask(sensors);
+	unsigned long mask_ms = systime() - begin;
+
+	if (switch_ms == 0) switch_ms = 1; // guard against dividing by zero on very short runs
+	if (mask_ms == 0) mask_ms = 1;
+	printf("switch walk:    %.0f ticks/s\n", iterations * 1000.0 / switch_ms);
+	printf("bitmask:        %.0f ticks/s\n", iterations * 1000.0 / mask_ms);
+	(void)winner;
+}
+#endif
+/******************************************************/
+
+//=======================================//
+//===============TELEMETRY===============//
+//=======================================//
+
+void open_telemetry()
+{
+	// create and map the telemetry file once at start up, so logging a tick later is only a copy into memory.  The last run's file is kept as <path>.prev,
+	// so the log of a run that ended in a crash or a brown-out restart survives the reboot
+	size_t size = sizeof(telemetry_header) + TELEMETRY_RECORDS * sizeof(telemetry_record);
+	char previous_path[256];
+	if (snprintf(previous_path, sizeof(previous_path), "%s.prev", telemetry_path) < (int)sizeof(previous_path)) rename(telemetry_path, previous_path); // fails harmlessly if there is no old file
+	int file = open(telemetry_path, O_RDWR | O_CREAT, 0644);
+	if (file < 0 || ftruncate(file, size) != 0){
+		printf("telemetry off, could not create %s\n", telemetry_path);
+		if (file >= 0) close(file);
+		return;
+	}
+	void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	close(file); // the mapping keeps the file open
+	if (memory == MAP_FAILED){
+		printf("telemetry off, could not map %s\n", telemetry_path);
+		return;
+	}
+	memset(memory, 0, size); // touch every page now, so the control loop never waits on the file system for a fresh page
+
+	telemetry = memory;
+	memcpy(telemetry->magic, TELEMETRY_MAGIC, sizeof(telemetry->magic));
+	telemetry->version = TELEMETRY_VERSION;
+	telemetry->record_size = sizeof(telemetry_record);
+	telemetry->capacity = TELEMETRY_RECORDS;
+	telemetry->record_count = 0;
+	telemetry_records = (telemetry_record *)(telemetry + 1);
+}
+/******************************************************/
+void log_telemetry(const sensor_snapshot *sensors)
+{
+	// append this tick's record to the ring in the mapped file, overwriting the oldest once it is full.  No system call, the kernel writes the pages back on its own
+	if (telemetry == NULL) return;
+	unsigned long long count = telemetry->record_count;
+	telemetry_record *record = &telemetry_records[count % TELEMETRY_RECORDS];
+	record->timestamp = sensors->timestamp;
+	record->tick = tick_count;
+	record->timer_duration = timer_duration;
+	record->right_photo = sensors->right_photo;
+	record->left_photo = sensors->left_photo;
+	record->right_ir = sensors->right_ir;
+	record->left_ir = sensors->left_ir;
+	record->left_position = last_left_position;
+	record->right_position = last_right_position;
+	record->left_motion = sensors->left_motion;
+	record->right_motion = sensors->right_motion;
+	record->bumps = sensors->bumps;
+	record->sensors_read = sensors->sensors_read;
+	record->winner = tick_winner;
+	record->phase = running_phase;
+	atomic_thread_fence(memory_order_release); // anyone reading the file while we run sees the whole record before the count that includes it
+	telemetry->record_count = count + 1;
+}
+/******************************************************/
+
+//======================================//
+//===============PROFILES===============//
+//======================================//
+
+bool open_profiles()
+{
+	// map the profile file, starting a fresh one if it is missing or not a version PROFILE_VERSION file, and pick the slot to use
+	size_t size = sizeof(profile_header) + PROFILE_SLOTS * PROFILE_COPIES * sizeof(profile_slot);
+	int file = open(profile_path, O_RDWR | O_CREAT, 0644);
+	struct stat info;
+	if (file < 0 || fstat(file, &info) != 0 || ((size_t)info.st_size < size && ftruncate(file, size) != 0)){
+		printf("profiles off, could not open %s\n", profile_path);
+		if (file >= 0) close(file);
+		return false;
+	}
+	void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	close(file); // the mapping keeps the file open
+	if (memory == MAP_FAILED){
+		printf("profiles off, could not map %s\n", profile_path);
+		return false;
+	}
+
+	profiles = memory;
+	if (memcmp(profiles->magic, PROFILE_MAGIC, sizeof(profiles->magic)) != 0 || profiles->version != PROFILE_VERSION
+		|| profiles->slot_size != sizeof(profile_slot) || profiles->slot_count != PROFILE_SLOTS){
+		memset(memory, 0, size); // an empty or foreign file: start over with every slot free
+		memcpy(profiles->magic, PROFILE_MAGIC, sizeof(profiles->magic));
+		profiles->version = PROFILE_VERSION;
+		profiles->slot_size = sizeof(profile_slot);
+		profiles->slot_count = PROFILE_SLOTS;
+	}
+	profile_slot *slots = (profile_slot *)(profiles + 1);
+
+	int slot = (profiles->current_slot >= 0 && profiles->current_slot < PROFILE_SLOTS) ? profiles->current_slot : 0;
+	if (profile_name != NULL){
+		int free_slot = -1, i, j;
+		slot = -1;
+		for (i = 0; i < PROFILE_SLOTS && slot < 0; i++){
+			bool unused = true; // no copy named or ever saved
+			for (j = 0; j < PROFILE_COPIES; j++){
+				const profile_slot *copy = &slots[i * PROFILE_COPIES + j];
+				if (strncmp(copy->name, profile_name, PROFILE_NAME_LENGTH - 1) == 0) slot = i;
+				if (copy->name[0] != '\0' || copy->saves != 0) unused = false;
+			}
+			if (slot < 0 && unused && free_slot < 0) free_slot = i;
+		}
+		if (slot < 0 && free_slot < 0){
+			printf("profiles off, all %d slots of %s are taken\n", PROFILE_SLOTS, profile_path);
+			munmap(memory, size);
+			profiles = NULL;
+			return false;
+		}
+		if (slot < 0){
+			slot = free_slot; // a new name claims a free slot, saved for the first time at the next change
+			memset(&slots[slot * PROFILE_COPIES], 0, PROFILE_COPIES * sizeof(profile_slot));
+			for (i = 0; i < PROFILE_COPIES; i++) strncpy(slots[slot * PROFILE_COPIES + i].name, profile_name, PROFILE_NAME_LENGTH - 1);
+		}
+	}
+	profile_copies = &slots[slot * PROFILE_COPIES];
+	profiles->current_slot = slot;
+	return true;
+}
+/******************************************************/
+void renumber_ranks()
+{
+	// after sorting, make the ranks of the active behaviors sequential with a step size of one, and give inactive behaviors a constant "poor" rank which is helpful to ensure new ones always jump above
+	size_t i;
+	for (i = 0; i < hierarchy_length; i++){
+		if (subsumption_hierarchy[i].is_active) subsumption_hierarchy[i].rank = i;
+		else subsumption_hierarchy[i].rank = hierarchy_length + 1;
+	}
+}
+/******************************************************/
+profile_slot *newest_profile()
+{
+	// the copy of the slot in use saved last that holds a whole configuration, NULL if none does
+	if (profile_copies == NULL) return NULL;
+	profile_slot *newest = NULL;
+	int i;
+	for (i = 0; i < PROFILE_COPIES; i++){
+		profile_slot *copy = &profile_copies[i];
+		if (copy->saves == 0 || copy->checksum != profile_checksum(copy) || copy->behavior_count > PROFILE_BEHAVIORS) continue;
+		if (newest == NULL || copy->saves > newest->saves) newest = copy;
+	}
+	return newest;
+}
+/******************************************************/
+bool restore_profile()
+{
+	// put the hierarchy and thresholds of the profile slot in place, if a copy of it holds a whole saved configuration
+	const profile_slot *profile = newest_profile();
+	if (profile == NULL) return false;
+	size_t i, j;
+	for (i = 0; i < hierarchy_length; i++){
+		subsumption_hierarchy[i].is_active = false; // behaviors the profile doesn't know go to the bottom, inactive
+		subsumption_hierarchy[i].rank = PROFILE_BEHAVIORS + i;
+	}
+	for (j = 0; j < profile->behavior_count; j++){
+		for (i = 0; i < hierarchy_length; i++){
+			if (subsumption_hierarchy[i].type != profile->types[j]) continue;
+			subsumption_hierarchy[i].rank = j;
+			subsumption_hierarchy[i].is_active = profile->active[j];
+		}
+	}
+	qsort(subsumption_hierarchy, hierarchy_length, sizeof(behavior), compare_ranks);
+	renumber_ranks();
+	avoid_threshold = profile->avoid_threshold;
+	approach_threshold = profile->approach_threshold;
+	photo_threshold = profile->photo_threshold;
+	motion_threshold = profile->motion_threshold;
+	motion_attracts = profile->motion_attracts != 0;
+	printf("restored profile %s\n", profile->name);
+	return true;
+}
+/******************************************************/
+void save_profile()
+{
+	// copy the hierarchy, top down, and the thresholds into the older copy of the profile slot, leaving the newest whole one alone.  The checksum
+	// goes in last, so a save cut short is never restored and the next boot falls back on the configuration saved before it
+	if (profile_copies == NULL) return;
+	const profile_slot *previous = newest_profile();
+	profile_slot *profile = NULL; // the oldest of the other copies
+	int copy;
+	for (copy = 0; copy < PROFILE_COPIES; copy++){
+		if (&profile_copies[copy] != previous && (profile == NULL || profile_copies[copy].saves < profile->saves)) profile = &profile_copies[copy];
+	}
+	profile->checksum = 0;
+	atomic_thread_fence(memory_order_release); // the stale checksum is gone before any of the copy changes
+	size_t i;
+	profile->behavior_count = hierarchy_length < PROFILE_BEHAVIORS ? hierarchy_length : PROFILE_BEHAVIORS;
+	for (i = 0; i < profile->behavior_count; i++){
+		profile->types[i] = subsumption_hierarchy[i].type;
+		profile->active[i] = subsumption_hierarchy[i].is_active;
+	}
+	profile->avoid_threshold = avoid_threshold;
+	profile->approach_threshold = approach_threshold;
+	profile->photo_threshold = photo_threshold;
+	profile->motion_threshold = motion_threshold;
+	profile->motion_attracts = motion_attracts;
+	memset(profile->padding, 0, sizeof(profile->padding)); // covered by the checksum
+	if (previous != NULL) memcpy(profile->name, previous->name, sizeof(profile->name));
+	else if (profile->name[0] == '\0') strcpy(profile->name, "default"); // a slot first saved without a profile_name
+	profile->saves = (previous != NULL ? previous->saves : profile->saves) + 1;
+	atomic_thread_fence(memory_order_release); // the whole copy is in place before the checksum that makes it valid
+	profile->checksum = profile_checksum(profile);
+	profiles->current_slot = (profile_copies - (profile_slot *)(profiles + 1)) / PROFILE_COPIES;
+	// start writing it back now rather than whenever the kernel gets to it.  MS_ASYNC doesn't wait, so a power cut soon after can still lose this
+	// save, but not the copy saved before it
+	msync(profiles, sizeof(profile_header) + PROFILE_SLOTS * PROFILE_COPIES * sizeof(profile_slot), MS_ASYNC);
+}
+/******************************************************/
+
+//=====================================//
+//===============LATENCY===============//
+//=====================================//
+
+int latency_bucket(unsigned long long nanos)
+{
+	// values below LATENCY_SUB_BUCKETS get a bucket each, above that every power of two is split into LATENCY_SUB_BUCKETS equal buckets
+	if (nanos < LATENCY_SUB_BUCKETS) return (int)nanos;
+	int magnitude = 63 - __builtin_clzll(nanos); // the highest set bit, at least 4
+	int bucket = (magnitude - 3) * LATENCY_SUB_BUCKETS + (int)((nanos >> (magnitude - 4)) - LATENCY_SUB_BUCKETS);
+	return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
+/******************************************************/
+unsigned long long latency_bucket_top(int bucket)
+{
+	// the largest duration that lands in a bucket, what a percentile falling in it is reported as
+	if (bucket < LATENCY_SUB_BUCKETS) return bucket;
+	int magnitude = bucket / LATENCY_SUB_BUCKETS + 3;
+	unsigned long long bottom = (unsigned long long)(bucket % LATENCY_SUB_BUCKETS + LATENCY_SUB_BUCKETS) << (magnitude - 4);
+	return bottom + (1ULL << (magnitude - 4)) - 1;
+}
+/******************************************************/
+void record_latency(int stage, unsigned long long nanos)
+{
+	// one increment and a compare, no allocation and no locks
+	if (!use_latency_histograms) return;
+	latency_histogram *histogram = &latency_histograms[stage];
+	histogram->buckets[latency_bucket(nanos)]++;
+	histogram->count++;
+	if (nanos > histogram->max) histogram->max = nanos;
+}
+/******************************************************/
+unsigned long long record_stage(int stage, unsigned long long begin)
+{
+	// record the time since begin for a stage and return the current time, which is where the next stage begins
+	unsigned long long now = stage_clock();
+	record_latency(stage, now - begin);
+	return now;
+}
+/******************************************************/
+unsigned long long latency_percentile(const latency_histogram *histogram, double fraction)
+{
+	if (histogram->count == 0) return 0;
+	unsigned long rank = (unsigned long)(fraction * histogram->count + 0.999999); // the rank of the duration that fraction of them are at or below
+	if (rank == 0) rank = 1;
+	unsigned long seen = 0;
+	int bucket;
+	for (bucket = 0; bucket < LATENCY_BUCKETS; bucket++){
+		seen += histogram->buckets[bucket];
+		if (seen >= rank) break;
+	}
+	unsigned long long top = latency_bucket_top(bucket);
+	return top < histogram->max ? top : histogram->max;
+}
+/******************************************************/
+void request_latency_report(int signal_number)
+{
+	(void)signal_number;
+	latency_report_requested = 1; // printing isn't safe in a signal handler, so leave it to the control loop
+}
+/******************************************************/
+void print_latency_report()
+{
+	// p50/p99/max of every stage since the program started, to latency_path or the console.  This is slow, so only on request
+	FILE *out = latency_path ? fopen(latency_path, "a") : stdout;
+	if (out == NULL){
+		printf("could not open %s for the latency report\n", latency_path);
+		return;
+	}
+	fprintf(out, "%-20s %10s %10s %10s %10s\n", "stage (us)", "count", "p50", "p99", "max");
+	int stage;
+	for (stage = 0; stage < STAGE_COUNT; stage++){
+		const latency_histogram *histogram = &latency_histograms[stage];
+		fprintf(out, "%-20s %10lu %10.1f %10.1f %10.1f\n", stage_names[stage], histogram->count, latency_percentile(histogram, 0.5) / 1000.0,
+			latency_percentile(histogram, 0.99) / 1000.0, histogram->max / 1000.0);
+	}
+	if (out != stdout) fclose(out);
+	else fflush(stdout);
+}
+/******************************************************/
+bool latency_report_due()
+{
+	// a report is due after SIGUSR1, or when A and C are pressed together while operating (the buttons have no other use then).
+	// The buttons are only looked at every LATENCY_COMBO_TICKS ticks, so the ticks being timed don't pay for reading them
+	bool due = latency_report_requested;
+	latency_report_requested = 0;
+	if (tick_count % LATENCY_COMBO_TICKS == 0){
+		bool combo = !show_gui && a_button() && c_button();
+		due = due || (combo && !latency_combo_held);
+		latency_combo_held = combo;
+	}
+	return due;
+}
 /******************************************************/
 
 //===============================GUI RELATED CODE========================================
@@ -287,32 +1410,85 @@ void randomize_hierarchy(){
 	}
 	qsort(subsumption_hierarchy, hierarchy_length, sizeof(behavior), compare_ranks); //sort our hierarchy based on rank value
 }*/
+//-------------------------RETAINED UI STATE--------------------
+void set_button_text(int button, const char *text){
+	//push a button's text only if it differs from what the button already shows
+	if(button_texts[button] != NULL && strcmp(button_texts[button], text) == 0){
+		ui_skips++;
+		return;
+	}
+	switch(button){
+		case A_BUTTON: set_a_button_text(text); break;
+		case B_BUTTON: set_b_button_text(text); break;
+		case C_BUTTON: set_c_button_text(text); break;
+		case X_BUTTON: set_x_button_text(text); break;
+		case Y_BUTTON: set_y_button_text(text); break;
+		case Z_BUTTON: set_z_button_text(text); break;
+	}
+	button_texts[button] = text; //only ever string literals, so keeping the pointer is enough
+	ui_pushes++;
+}
+
+void set_extra_buttons(int visible){
+	if(visible == extra_buttons_visible){
+		ui_skips++;
+		return;
+	}
+	set_extra_buttons_visible(visible);
+	extra_buttons_visible = visible;
+	ui_pushes++;
+}
+
+void display_row(int row, const char *format, ...){
+	//write a whole console row, but only if its text differs from what the row already shows
+	char text[SCREEN_COLUMNS + 1];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(text, sizeof(text), format, args);
+	va_end(args);
+	if(row < SCREEN_ROWS){
+		if(strcmp(screen_rows[row], text) == 0){
+			ui_skips++;
+			return;
+		}
+		strcpy(screen_rows[row], text);
+	}
+	display_printf(0, row, "%s", text);
+	ui_pushes++;
+}
+
+void clear_screen(){
+	//clear the console and forget what the rows showed, so the next display_row of each row is written
+	console_clear();
+	memset(screen_rows, 0, sizeof(screen_rows));
+}
+//-------------------------MANAGE SCREEN PRINTING OF LOOP TIMING--------------------
+void print_loop_stats(int row){
+	unsigned long average_jitter = tick_count ? total_jitter / tick_count : 0;
+	display_row(row, "Ticks: %lu  Overruns: %lu  Jitter avg/max: %lu/%lu ms   ", tick_count, overrun_count, average_jitter, max_jitter);
+	display_row(row + 1, "Servo writes: %lu  Suppressed: %lu  Superseded: %lu   ", servo_writes, suppressed_writes, superseded_commands);
+	display_row(row + 2, "Sensor samples: %lu  Pin reads: %lu  Max sample age: %llu us   ", (unsigned long)atomic_load(&sensor_count), (unsigned long)atomic_load_explicit(&pin_reads, memory_order_relaxed), max_sensor_age);
+	unsigned long long average_reaction = reaction_count ? total_reaction_time / reaction_count : 0;
+	display_row(row + 3, "%s reactions: %lu  avg/max: %llu/%llu ms  Missed: %lu   ", preemptive_actions ? "Preemptive" : "Blocking", reaction_count, average_reaction / 1000, max_reaction_time / 1000, missed_reactions);
+	display_row(row + 4, "Log events: %lu  Dropped: %lu  UI pushes: %lu  Skipped: %lu   ", (unsigned long)atomic_load(&log_head), log_drops, ui_pushes, ui_skips);
+	unsigned int scores = atomic_load(&motion_scores);
+	display_row(row + 5, "Vision %s  Frames: %lu  Motion left/right: %u/%u   ", vision_started ? "on" : "off", (unsigned long)atomic_load_explicit(&vision_frames, memory_order_relaxed), scores >> 16, scores & 0xFFFF);
+}
 //-------------------------MANAGE SCREEN PRINTING OF GUI--------------------
 void print_subsumption_hierarchy(struct behavior *array, size_t len){ 
 	size_t i;
 	for(i=0; i<len; i++){
-		display_printf(1,i,"%s          ",array[i].title);
-		if(array[i].is_active){
-			display_printf(17,i,"Active  ");
-		}
-		else{
-			display_printf(17,i,"Inactive ");
-		}
-		if(i == cursor_row){
-			display_printf(0, i, ">");
-			display_printf(25, i, "<");
-		}
-		else{
-			display_printf(0, i, " ");
-			display_printf(25, i, " ");
-		}
+		bool is_cursor = (i == cursor_row);
+		//cursor in column 0, title from column 1, state from column 17, cursor again in column 25; only rows that changed are written
+		display_row(i, "%c%-16.16s%-8s%c", is_cursor ? '>' : ' ', array[i].title, array[i].is_active ? "Active" : "Inactive", is_cursor ? '<' : ' ');
 		//display_printf(35, i, "%d", array[i].rank); //debug for showing rank
 	}
+	print_loop_stats(len + 1);
 }
 //--------------------MANAGE SCREEN PRINTING WHEN OPERATING---------------------
 void print_set_hierarchy(){ 
 	if(update_operating_console && !first_gui){
-		console_clear();
+		clear_screen();
 		size_t i;
 		for(i=0; i<hierarchy_length; i++){
 			if(subsumption_hierarchy[i].is_active) printf(" %s\n",subsumption_hierarchy[i].title);
@@ -338,16 +1514,16 @@ void update_gui(){
 		bool cursor_update = false;
 		bool hierarchy_update = false;
 		
-		set_extra_buttons_visible(1); //we turn off the extra buttons (buttons xyz) when we are not in showgui mode, so we need to activate them here
+		set_extra_buttons(1); //we turn off the extra buttons (buttons xyz) when we are not in showgui mode, so we need to activate them here (the cached setters only push what changed)
 		
-		set_a_button_text(subsumption_hierarchy[cursor_row].is_active?"Deactivate":"Activate"); //set text to display activate or deactivate based on the behavior the cursor is on
-		set_b_button_text(subsumption_hierarchy[cursor_row].is_active?"Move Up":""); //set text to display "move up" or nothing based on the behavior the cursor is on
-		set_y_button_text(subsumption_hierarchy[cursor_row].is_active?"Move Down":"");	//set text to display "move down" or nothing based on the behavior the cursor is on
+		set_button_text(A_BUTTON, subsumption_hierarchy[cursor_row].is_active?"Deactivate":"Activate"); //set text to display activate or deactivate based on the behavior the cursor is on
+		set_button_text(B_BUTTON, subsumption_hierarchy[cursor_row].is_active?"Move Up":""); //set text to display "move up" or nothing based on the behavior the cursor is on
+		set_button_text(Y_BUTTON, subsumption_hierarchy[cursor_row].is_active?"Move Down":"");	//set text to display "move down" or nothing based on the behavior the cursor is on
 		
-		set_c_button_text("\u25B2"); //up triangle unicode
-		set_z_button_text("\u25BC"); //unicode down triangle
+		set_button_text(C_BUTTON, "\u25B2"); //up triangle unicode
+		set_button_text(Z_BUTTON, "\u25BC"); //unicode down triangle
 		
-		set_x_button_text("Reset");	//reset button for deactivating all
+		set_button_text(X_BUTTON, "Reset");	//reset button for deactivating all
 		
 		if(c_button_clicked()){ //move the cursor up
 			cursor_row = (cursor_row - 1); //up cursor
@@ -388,23 +1564,25 @@ void update_gui(){
 			
 			qsort(subsumption_hierarchy, hierarchy_length, sizeof(behavior), compare_ranks); //sort our hierarchy based on rank value
 			
-			size_t i;
-			for(i=0; i<hierarchy_length; i++){
-				if(subsumption_hierarchy[i].is_active) subsumption_hierarchy[i].rank = i; //now reset the index of each sorted active behavior to be sequential with a step size of one
-				else subsumption_hierarchy[i].rank = hierarchy_length + 1; //give inactive behaviors a constant "poor" rank which is helpful to ensure new ones always jump above.
+			renumber_ranks(); //now reset the index of each sorted active behavior to be sequential
+			
+			if(hierarchy_update){
+				compile_hierarchy(); //the active set or its order changed, so rebuild the dispatch table the control loop walks
+				if(use_vision) start_vision_thread(); //MOTION may have just been activated
+				save_profile(); //and keep it for the next boot
 			}
 			
-			console_clear(); // clear the console
+			if(is_side_update || screen_rows[0][0] == '\0') clear_screen(); //coming from the operating console (or nothing of ours is on screen yet), so clear it; otherwise only the rows that changed are rewritten
 			print_subsumption_hierarchy(subsumption_hierarchy, hierarchy_length); //print the hierarchy and interface
 			is_side_update = false; //turn off the is_side_update boolean so we don't get screen flicker until we update the cursor or hierarchy next
 		}
 		
 	}
 	else{
-		set_a_button_text("");	//if we are not in show_gui mode, we must be operating, set our buttons to show nothing and hide the extra buttons
-		set_b_button_text("");	
-		set_c_button_text("");
-		set_extra_buttons_visible(0);
+		set_button_text(A_BUTTON, "");	//if we are not in show_gui mode, we must be operating, set our buttons to show nothing and hide the extra buttons (pushed once, not every tick)
+		set_button_text(B_BUTTON, "");	
+		set_button_text(C_BUTTON, "");
+		set_extra_buttons(0);
 	}
 }
 
@@ -416,81 +1594,84 @@ void update_gui(){
 
 int main() 
 {
-	hierarchy_length = sizeof(subsumption_hierarchy) / sizeof(behavior); //set this variable once for loopin trhough the hierarchy
+	if(use_profiles && open_profiles()) restore_profile(); //resume the configuration saved last, if there is one
+	compile_hierarchy(); //build the dispatch table for the boot hierarchy
+	if(use_sensor_thread) start_sensor_thread(); //start sampling the sensors in the background
+	if(use_vision) start_vision_thread(); //if the boot hierarchy has MOTION active, start watching the camera for motion in the background; the control loop only reads the latest scores
+	if(use_telemetry) open_telemetry(); //map the telemetry file before the first tick
+	if(use_latency_histograms) signal(SIGUSR1, request_latency_report); //kill -USR1 prints the latency report
+#ifndef NO_LOGGING
+	if(use_logger_thread) start_logger_thread(); //print diagnostics in the background
+#endif
 	
-	enable_servo(LEFT_MOTOR_PIN);	//initialize both motors and set speed to zero
-	enable_servo(RIGHT_MOTOR_PIN);
+#ifdef DISPATCH_BENCHMARK
+	benchmark_dispatch(1000000);
+#endif
+	
+	enable_motors();	//initialize both motors and set speed to zero
 	drive(0.0,0.0,1.0);
+	commit_motor_command();
+	preempting_mask = 0; //nothing cuts the start up pause short
+	next_tick_time = systime(); //the first tick is due right away
 	
 	while(true){ //this is an infinite loop (true is always true)
+		wait_for_next_tick(); //sleep until the next sensing tick or until the running action ends, whichever comes first
+		if(use_latency_histograms && latency_report_due()) print_latency_report(); //before the tick starts, so the report's own time isn't counted
+		unsigned long long tick_begin = stage_clock();
+		unsigned long long stage_begin = tick_begin;
 		update_gui(); //update our gui in any case
+		stage_begin = record_stage(GUI_STAGE, stage_begin);
 		
 		if(!show_gui){ //if we aren't showing the gui, we must be sensing and acting
 			
 			if(update_operating_console){
 				//only enable the servos once when returning from the gui menu, this boolean is disabled in the next print_set_hierarchy function
-				enable_servo(LEFT_MOTOR_PIN);
-				enable_servo(RIGHT_MOTOR_PIN);
+				enable_motors();
 				drive(0.0,0.0,2.0);
+				commit_motor_command(); //start the pause now so this tick's arbitration waits for it
+				preempting_mask = 0; //give the robot the whole pause to be put down, nothing cuts it short
+				outranking_onset = 0;
 			}
 			print_set_hierarchy(); //print the current subsumption hierarchy to the screen (only executes if gui has been accessed once before)
+			stage_begin = record_stage(CONSOLE_STAGE, stage_begin);
 			
-			read_sensors(); //read all sensors and set global variables of their readouts
+			sensor_snapshot latest;
+			sensor_snapshot *sensors;
+			if(use_sensor_thread){
+				latest_snapshot(&latest); //copy the freshest snapshot, this never waits for the sensors to be read
+				sensors = &latest;
+				unsigned long long sensor_age = monotonic_micros() - latest.timestamp;
+				if(sensor_age > max_sensor_age) max_sensor_age = sensor_age;
+			}
+			else{
+				sensors = begin_snapshot(); //an empty snapshot in the history ring, the arbitration reads only the sensors it needs into it
+			}
+			
+			unsigned long long snapshot_nanos = stage_clock() - stage_begin;
+			stage_begin += snapshot_nanos;
+			tick_read_nanos = 0;
 			
+			tick_winner = TELEMETRY_NO_ARBITRATION;
 			if(timer_elapsed()){ //any time a drive message is called, the timer is updated.  Until it is called again this should always return true
-				bool execute_action = false; //tell us if we have executed ANY action
-				size_t i;	//counter for hierarchy for loop
-				for(i=0; i<hierarchy_length; i++){ //for each behavior in our hierarchy
-					if(subsumption_hierarchy[i].is_active){ //if the behavior at this index is active...
-						switch(subsumption_hierarchy[i].type){ //run a switch/case statement to see which type this behavior is and do the appropriate action
-							//for the specified hierarchy type, check if we should execute the action, and do it if so.  If not, continue the for loop.  If so, execute action and break.
-							case SEEK_LIGHT_TYPE:
-							execute_action = is_above_photo_differential(photo_threshold);
-							if(execute_action) seek_light();
-							break;
-							case SEEK_DARK_TYPE:
-							execute_action = is_above_photo_differential(photo_threshold);
-							if(execute_action) seek_dark();
-							break;
-							case APPROACH_TYPE:
-							execute_action = is_above_distance_threshold(approach_threshold);
-							if(execute_action) approach();
-							break;
-							case AVOID_TYPE:
-							execute_action = is_above_distance_threshold(avoid_threshold);
-							if(execute_action) avoid();
-							break;
-							case ESCAPE_F_TYPE:
-							execute_action = is_front_bump();
-							if(execute_action) escape_front();
-							break;
-							case ESCAPE_B_TYPE:
-							execute_action = is_back_bump();
-							if(execute_action) escape_back();
-							break;
-							case CRUISE_S_TYPE:
-							execute_action = true;
-							cruise_straight();
-							break;
-							case CRUISE_A_TYPE:
-							execute_action = true;
-							cruise_arc();		
-							break;
-						} //end hierarchy type switch
-					} //end if active
-					if(execute_action){
-						break; //if any action was executed, break out of the subsumption hierarchy loop altogether
-					}//end if execute action	
-					else{
-						stop(); //if there is no action, stop
-					}
-				} //end for each item in hierarchy loop
+				arbitrate(sensors, !use_sensor_thread); //run the action of the highest ranked active behavior whose predicate is true
 			}//end if timer elapsed
+			else{
+				check_preemption(sensors, !use_sensor_thread); //keep watching the behaviors ranked above the running action, and let them cut it short in preemptive mode
+			}
+			if(!use_sensor_thread && sensors->sensors_read != 0) end_snapshot(); //publish what we read, if anything
+			unsigned long long decided = stage_clock();
+			record_latency(SENSOR_STAGE, snapshot_nanos + tick_read_nanos);
+			record_latency(ARBITRATION_STAGE, decided - stage_begin - tick_read_nanos);
+			
+			commit_motor_command(); //start the one action collected this tick, or move the running action on to its next phase
+			record_stage(COMMIT_STAGE, decided);
+			log_telemetry(sensors); //record what this tick saw and did
 		}//end if not show gui
 		
 		else{
 			disable_servos(); //disable all servo motors if we are in gui mode
 		}
+		record_stage(TICK_STAGE, tick_begin);
 	}//end while true
 	
 	return 0; //due to infinite while loop, we will never get here
@@ -47,6 +47,13 @@ const int LEFT_PHOTO_PIN = 1; // analog sensors (IRs, photos)
 #define RIGHT_MOTOR_PIN 0
 #define LEFT_MOTOR_PIN 1 // servos
 
+// *** Define log calls.  There is no logger thread here, so they print on the control loop; compile with -DLOGGING to turn them on *** //
+#ifdef LOGGING
+#define LOG_VALUES(format, a, b, c) printf(format, a, b, c)
+#else
+#define LOG_VALUES(format, a, b, c) ((void)0)
+#endif
+
 // *** Define a new kind of variable type called "behavior" that contains properties for type (indexing definitions above), rank, and an active/inactive boolean *** //
 typedef struct behavior{
 	const char *title;
@@ -79,6 +86,9 @@ bool is_front_bump();							 // return true if one of the front bumpers was hit
 bool is_back_bump();							 // return true if one of the back bumpers was hit
 bool timer_elapsed();							 // return true if our timer has elapsed
 
+//DECISION
+int decide();									 // run the action of the first behavior in the if/else chain whose condition holds, return its type
+
 //ACTIONS
 void escape_front();
 void escape_back();
@@ -117,6 +127,17 @@ int photo_threshold = 350;	   // the absolute difference between photo sensor re
 int timer_duration = 500;	  // the time in milliseconds to wait between calling action commands, changed by each drive command called by actions
 unsigned long start_time = 0; // store the system time each time we start an action so we can see if our time has elapsed without a blocking delay
 
+// decision
+int tick_winner = -1; // type of the behavior decide() chose this tick, -1 on ticks where the running action wasn't over yet
+
+// control loop scheduler
+int control_rate = 100;			  // how many times per second the control loop checks the action timer (Hz, 1 to 1000); the loop sleeps between ticks instead of spinning
+unsigned long next_tick_time = 0; // the system time (ms) at which the next fixed tick is due
+unsigned long tick_count = 0;	  // number of ticks the control loop has run
+unsigned long overrun_count = 0;  // number of ticks that started a whole period or more late (the loop body took too long)
+unsigned long max_jitter = 0;	  // the latest (ms) any tick has woken up after its deadline
+unsigned long total_jitter = 0;	  // sum of all tick lateness (ms), divide by tick_count for the average
+
 // *** Function Definitions *** //
 
 //this struct defines the initial behavior, but also describes all possible behaviors.  New ones could be added, or the order can be moved around.
@@ -143,6 +164,38 @@ bool timer_elapsed()
 	return (systime() > (start_time + timer_duration)); // return true if the current time is greater than our start time plus timer duration
 }
 /******************************************************/
+void wait_for_next_tick()
+{
+	int rate = control_rate < 1 ? 1 : (control_rate > 1000 ? 1000 : control_rate); // systime() counts whole ms, so 1000 Hz is the fastest tick
+	unsigned long period = 1000 / rate; // length of one tick in ms
+	unsigned long now = systime();
+	unsigned long deadline = next_tick_time;
+	unsigned long action_deadline = start_time + timer_duration + 1; // first time at which timer_elapsed() will return true
+
+	// wake up early if the running action ends before the next tick, so the next decision is not delayed by up to a whole period
+	if (action_deadline > now && action_deadline < deadline){
+		deadline = action_deadline;
+	}
+	if (deadline > now){
+		msleep(deadline - now); // give the processor back to anything else running on the controller
+		now = systime();
+	}
+
+	// keep track of how late we woke up compared to when we wanted to
+	unsigned long jitter = (now > deadline) ? now - deadline : 0;
+	total_jitter += jitter;
+	if (jitter > max_jitter) max_jitter = jitter;
+	tick_count++;
+
+	if (now >= next_tick_time + period){
+		overrun_count++;			 // we missed at least one whole tick, so start counting again from now instead of running a burst of late ticks
+		next_tick_time = now + period;
+	}
+	else if (now >= next_tick_time){
+		next_tick_time += period;	 // stay on the fixed grid of ticks so the rate doesn't drift
+	}
+}
+/******************************************************/
 float map(float value, float start_range_low, float start_range_high, float target_range_low, float target_range_high)
 {
 	return target_range_low + ((value - start_range_low) / (start_range_high - start_range_low)) * (target_range_high - target_range_low);
@@ -250,7 +303,7 @@ void seek_light()
 {
 	// greater photo_value means less light
 	int photo_difference = right_photo_value - left_photo_value;
-    printf("right_photo_value: %d, left_photo_value: %d, photo_difference: %d\n", right_photo_value, left_photo_value, photo_difference);
+	LOG_VALUES("right_photo_value: %d, left_photo_value: %d, photo_difference: %d\n", right_photo_value, left_photo_value, photo_difference);
 	// positive photo_difference means left sensor is brighter
 	if (photo_difference > 0){
 		drive(-0.2, 0.2, 0.10);
@@ -302,6 +355,41 @@ void approach()
 /******************************************************/
 /******************************************************/
 
+//======================================//
+//===============DECISION===============//
+//======================================//
+
+int decide()
+{
+	// the fixed hierarchy: only sensor globals in, only an action out, so a recorded sensor stream can be replayed through it
+	if(is_front_bump())
+	{
+		escape_front();
+		return ESCAPE_F_TYPE;
+	}
+	else if(is_above_distance_threshold(avoid_threshold))
+	{
+		avoid();
+		return AVOID_TYPE;
+	}
+	/*else if(is_back_bump())
+	{
+		escape_back();
+		return ESCAPE_B_TYPE;
+	}*/
+	else if(is_above_photo_differential(photo_threshold))
+	{
+		seek_light();
+		return SEEK_LIGHT_TYPE;
+	}
+	else
+	{
+		cruise_straight();
+		return CRUISE_S_TYPE;
+	}
+}
+/******************************************************/
+
 //==================================//
 //===============MAIN===============//
 //==================================//
@@ -313,37 +401,14 @@ int main()
 	enable_servo(LEFT_MOTOR_PIN);	//initialize both motors and set speed to zero
 	enable_servo(RIGHT_MOTOR_PIN);
 	drive(0.0,0.0,1.0);
+	next_tick_time = systime(); //the first tick is due right away
 	
 	while(true){ //this is an infinite loop (true is always true)
+		wait_for_next_tick(); //sleep until the next tick or until the running action ends, whichever comes first
+		tick_winner = -1;
 		if(timer_elapsed()){
-           
             read_sensors(); //read all sensors and set global variables of their readouts
-           
-            if(is_front_bump())
-            {
-                escape_front();
-                //continue;
-            }
-            else if(is_above_distance_threshold(avoid_threshold))
-            {
-                avoid();
-            }
-            /*else if(is_back_bump())
-            {
-                escape_back();
-                //continue;
-            }*/
-            else if(is_above_photo_differential(photo_threshold))
-            {
-                seek_light();
-			}
-            else
-            {
-                cruise_straight();
-                //continue;
-            }
-            //seek_light();
-            //cruise_straight();
+            tick_winner = decide(); //pick and start the action for these readings
         }
     }//end while true
 	
@@ -0,0 +1,27 @@
+/*
+Vassar Cognitive Science - Robot Ethology
+
+Runs many independent simulations across all processor cores.
+
+The robot programs keep their whole state in globals and can only run once per process, so every task runs in its own forked
+process that starts from the program's initial globals.  One worker per core pulls the next task from a shared counter as soon as
+it finishes the last one, so a few slow tasks never leave the other cores idle.
+*/
+
+#ifndef RE_BATCH_H
+#define RE_BATCH_H
+
+#include <stddef.h>
+
+// fill result (result_size bytes, zeroed beforehand) for task number index
+typedef void (*batch_task)(int index, void *result, void *context);
+
+// run task for every index in [0, count) on jobs processes (0 means one per core) and copy each task's result into
+// results[index * result_size].  Tasks that crash leave their result zeroed and are counted in the return value; if no worker
+// process can be started at all, nothing runs and every task counts as failed.
+// If progress is true a progress line is printed to stderr while the batch runs.
+int batch_run(int count, int jobs, batch_task task, void *context, void *results, size_t result_size, int progress);
+
+int batch_cores(); // number of processor cores available
+
+#endif
@@ -0,0 +1,30 @@
+/*
+Vassar Cognitive Science - Robot Ethology
+
+Microbenchmarks for the hot paths of the robot programs, run on the host against the simulated library (include/kipr/wombat.h).
+
+Each benchmark is a function that runs the code under test a given number of times.  bench_run() picks a count that takes long
+enough to time, takes the median of several samples and prints time per call, calls per second, bytes per second (when the
+benchmark says how many bytes one call works through) and heap allocations per call.  Use it before and after a change to see
+whether the change paid off.
+*/
+
+#ifndef RE_BENCH_H
+#define RE_BENCH_H
+
+// run the code under test iterations times
+typedef void (*bench_body)(long iterations, void *context);
+
+// time body and print one result line.  bytes is how much data one call works through, 0 if that doesn't mean anything
+void bench_run(const char *name, bench_body body, void *context, double bytes);
+
+// keep a value alive so the compiler can't optimize away the code that computed it
+extern volatile long bench_sink;
+
+// defined by the robot program's suite (bench_gui.c or bench_plain.c): call bench_run() for every benchmark in it
+void run_benchmarks();
+
+// the camera suite (bench_camera.c), run by both
+void bench_camera();
+
+#endif
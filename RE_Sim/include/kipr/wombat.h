@@ -0,0 +1,82 @@
+/*
+Vassar Cognitive Science - Robot Ethology
+
+Simulated stand-in for the KIPR Wombat library.  Robot programs include <kipr/wombat.h> as usual; when they are built from RE_Sim
+this header is found first, and every call below is answered by the simulated world in sim_world.c instead of the real hardware.
+
+Time is virtual: systime() and the monotonic clock only move forward when the program sleeps (msleep), so a program driven by the
+control loop scheduler runs as fast as the CPU allows.
+*/
+
+#ifndef KIPR_WOMBAT_SIM_H
+#define KIPR_WOMBAT_SIM_H
+
+#include <stdio.h>
+#include <time.h>
+
+// *** Sensors *** //
+int analog(int port);		// 12-bit analog value (0-4095) of the simulated sensor wired to port
+int analog10(int port);		// the same reading scaled to 10 bits (0-1023)
+int analog_et(int port);	// the same reading, ET sensors are wired like any other analog sensor in the simulator
+int digital(int port);		// 0 while the simulated bumper wired to port is pressed, otherwise 1
+
+// *** Servos *** //
+void enable_servo(int port);
+void disable_servo(int port);
+void enable_servos();
+void disable_servos();
+void set_servo_position(int port, int position); // 0-2047, drives the wheel on that port like a continuous rotation servo
+int get_servo_position(int port);
+
+// *** Time *** //
+unsigned long systime();	// virtual milliseconds since the simulation started
+void msleep(long msecs);	// advance the virtual clock (and the world) by msecs
+double seconds();
+int sim_clock_gettime(clockid_t clock, struct timespec *now); // virtual time for every clock
+#define clock_gettime sim_clock_gettime
+
+// *** Buttons and screen *** //
+int side_button_clicked();
+int side_button();
+int a_button(); // held down right now
+int c_button();
+int a_button_clicked();
+int b_button_clicked();
+int c_button_clicked();
+int x_button_clicked();
+int y_button_clicked();
+int z_button_clicked();
+void set_a_button_text(const char *text);
+void set_b_button_text(const char *text);
+void set_c_button_text(const char *text);
+void set_x_button_text(const char *text);
+void set_y_button_text(const char *text);
+void set_z_button_text(const char *text);
+void set_extra_buttons_visible(int visible);
+void display_printf(int column, int row, const char *format, ...);
+void console_clear();
+
+// *** Camera and graphics, a synthetic camera and a screen that draws nothing *** //
+enum Encoding { RGB, BGR };
+int camera_open();
+int camera_update();
+const unsigned char *get_camera_frame(); // BGR, get_camera_width() * get_camera_height() * 3 bytes
+int get_camera_width();
+int get_camera_height();
+void camera_close();
+int graphics_open(int width, int height);
+void graphics_close();
+void graphics_update();
+void graphics_pixel(int x, int y, int red, int green, int blue);
+void graphics_blit_enc(const unsigned char *data, enum Encoding encoding, int x, int y, int width, int height);
+int get_key_state(int key);
+
+// *** Threads *** //
+typedef void (*thread_function)();
+typedef struct sim_thread *thread;
+thread thread_create(thread_function function); // threads are not simulated, see sim_wombat.c
+void thread_start(thread id);
+void thread_wait(thread id);
+void thread_destroy(thread id);
+
+#endif
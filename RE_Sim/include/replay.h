@@ -0,0 +1,21 @@
+/*
+Vassar Cognitive Science - Robot Ethology
+
+Replays a recorded sensor stream through a robot program.  replay_world.c stands in for the simulated world: instead of driving a
+simulated robot around, every analog() and digital() call returns what the real robot read at the same time into its run.
+*/
+
+#ifndef RE_REPLAY_H
+#define RE_REPLAY_H
+
+#include <stdbool.h>
+
+bool replay_open(const char *path);	// map a telemetry file (RE_GUI/include/telemetry.h) as the sensor stream, false and a message on stderr if it can't be used
+double replay_seconds();			// time the trace covers
+unsigned long long replay_ticks();	// records in the trace
+
+// called with the recorded motion scores whenever a record read the VISION group, if the program's glue defines it (robot.c for
+// RE_GUI); the vision thread is not simulated, so this is the only way the program sees them
+void replay_motion(int left, int right);
+
+#endif
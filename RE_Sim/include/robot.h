@@ -0,0 +1,49 @@
+/*
+Vassar Cognitive Science - Robot Ethology
+
+The globals of RE_GUI/src/main.c that the simulator and the batch tools set before each simulated run, and helpers to set them.
+Only tools linked with RE_GUI may include this, and every one of them links robot.c.
+*/
+
+#ifndef RE_ROBOT_H
+#define RE_ROBOT_H
+
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "behavior.h" // RE_GUI's behavior struct and type keys, so its subsumption_hierarchy can be rearranged
+
+extern behavior subsumption_hierarchy[];
+extern int hierarchy_length;
+
+// switches sim_program_reset() sets for every simulated run
+extern bool use_sensor_thread, use_logger_thread, use_vision, use_telemetry, use_profiles;
+extern const char *telemetry_path;
+
+// the latest motion scores of the vision thread, left in the high 16 bits and right in the low 16
+extern atomic_uint motion_scores;
+
+// thresholds and action tuning
+extern int avoid_threshold, approach_threshold, photo_threshold;
+extern float cruise_speed, cruise_time, avoid_turn_speed, avoid_turn_time, seek_turn_speed, seek_turn_time;
+
+// *** Define a tunable: one of the globals above, looked up by name *** //
+typedef struct robot_tunable{
+	const char *name;
+	int *int_value;		// exactly one of these two is set
+	float *float_value;
+} robot_tunable;
+
+extern const robot_tunable robot_tunables[];
+extern const int robot_tunable_count;
+
+const robot_tunable *find_tunable(const char *name);
+double get_tunable(const robot_tunable *tunable);
+void set_tunable(const robot_tunable *tunable, double value);
+
+// make the behaviors with these titles (comma separated, highest ranked first) the active hierarchy, the rest inactive.
+// returns false, naming the culprit on stderr, if a title is unknown or repeated
+bool set_hierarchy(const char *titles);
+// the same with the hierarchy given as behavior indexes into the original subsumption_hierarchy order
+void set_hierarchy_order(const int *indexes, int count);
+
+#endif
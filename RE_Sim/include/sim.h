@@ -0,0 +1,92 @@
+/*
+Vassar Cognitive Science - Robot Ethology
+
+Headless simulator for the robot programs in this repository.
+
+A two wheeled, differential drive robot (IR, photo and bumper sensors wired like the RE_GUI robot) drives around a walled arena
+with a few round obstacles and a single light.  The simulated wombat.h calls read and drive this world, and a virtual clock means
+a robot program runs thousands of simulated minutes per wall clock minute.
+*/
+
+#ifndef RE_SIM_H
+#define RE_SIM_H
+
+#include <stdbool.h>
+
+#define SIM_MAX_OBSTACLES 8
+
+// *** Define how the simulated robot is wired, defaults match RE_GUI/src/main.c and RE_Plain/src/main.c *** //
+typedef struct sim_wiring{
+	int right_ir_pin, left_ir_pin, right_photo_pin, left_photo_pin;	// analog ports
+	int front_bump_left_pin, front_bump_center_pin, front_bump_right_pin;	// digital ports
+	int back_bump_left_pin, back_bump_center_pin, back_bump_right_pin;
+	int right_motor_pin, left_motor_pin;	// servo ports
+	bool right_motor_reversed;	// true if a higher servo position drives the right wheel backwards (mirrored servo)
+	bool left_motor_reversed;
+} sim_wiring;
+
+// *** Define one simulation run *** //
+typedef struct sim_config{
+	double duration;			// simulated seconds before the run ends
+	double arena_width;			// meters
+	double arena_height;		// meters
+	int obstacle_count;			// round obstacles placed at random (from seed) in the arena, at most SIM_MAX_OBSTACLES
+	double light_x, light_y;	// position of the light (meters)
+	double near_light_radius;	// the robot counts as near the light within this distance (meters)
+	double start_x, start_y;	// starting position of the robot (meters)
+	double start_heading;		// starting heading (radians, 0 points along +x)
+	double sensor_noise;		// standard deviation of the noise added to every analog reading
+	unsigned int seed;			// seeds obstacle placement and sensor noise, the same seed gives the same run
+	bool press_side_button;		// click the side button once at the start, so GUI programs leave their menu and start operating
+	bool show_output;			// let the robot program's printf output through (it is discarded otherwise)
+	const char *telemetry_path;	// where RE_GUI writes its telemetry file, NULL leaves telemetry off
+	sim_wiring wiring;
+} sim_config;
+
+// *** Define what a run measured *** //
+typedef struct sim_metrics{
+	double sim_seconds;			// simulated time covered by the run
+	double wall_seconds;		// real time the run took
+	double distance;			// meters the robot's center travelled
+	double time_near_light;		// simulated seconds spent within near_light_radius of the light
+	int collisions;				// times any bumper went from released to pressed
+	unsigned long servo_writes;	// set_servo_position calls the program made
+} sim_metrics;
+
+void sim_default_config(sim_config *config);
+
+// run a robot program's main function (built with -Dmain=robot_main) in a fresh world until config->duration simulated seconds have passed.
+// robot programs keep their state in globals, so each process can only run a program once
+int sim_run(const sim_config *config, int (*robot_main)(), sim_metrics *metrics);
+
+// set up the world and the simulated library as sim_run() does, without running a program (for benchmarks).
+// systime() still advances on heavy polling, so give config->duration room for that
+void sim_reset(const sim_config *config);
+
+// size of the frames the simulated camera delivers (160x120 to start with)
+void sim_camera_size(int width, int height);
+
+// called at the start of every msleep(), so once per control tick of a program that sleeps between ticks; NULL for none
+extern void (*sim_tick_hook)();
+
+// called at the end of sim_reset() to set up the program's own switches for a simulated run, if the program's glue defines it
+// (robot.c for RE_GUI); a program that needs nothing changed leaves it out
+void sim_program_reset(const sim_config *config);
+
+// *** World model, used by sim_wombat.c: sim_world.c simulates one, replay_world.c plays back a recorded one *** //
+void world_reset(const sim_config *config);
+void world_step(double dt, double left_speed, double right_speed);	// move the robot for dt seconds with wheel speeds between -1 and 1
+double world_ir(bool left);				// noise free analog reading of the left or right IR sensor
+double world_photo(bool left);			// noise free analog reading of the left or right photo sensor, greater means darker
+unsigned char world_bumps();			// SIM_BUMP_* bits of the bumpers in contact with something
+double world_gaussian();				// seeded normal noise, mean 0 and standard deviation 1
+void world_metrics(sim_metrics *metrics);
+
+#define SIM_BUMP_FRONT_LEFT 0x01
+#define SIM_BUMP_FRONT_CENTER 0x02
+#define SIM_BUMP_FRONT_RIGHT 0x04
+#define SIM_BUMP_BACK_LEFT 0x08
+#define SIM_BUMP_BACK_CENTER 0x10
+#define SIM_BUMP_BACK_RIGHT 0x20
+
+#endif
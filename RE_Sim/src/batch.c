@@ -0,0 +1,106 @@
+/*
+Vassar Cognitive Science - Robot Ethology
+
+Process pool for batches of simulations, see include/batch.h.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "batch.h"
+
+// *** Define the memory shared by the coordinator, the workers and the task processes *** //
+typedef struct batch_shared{
+	atomic_int next_task;	// the next task a worker may take
+	atomic_int finished;	// tasks completed so far, successful or not
+	atomic_int failed;		// tasks whose process crashed or exited with an error
+} batch_shared;
+
+/******************************************************/
+int batch_cores()
+{
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	return cores > 0 ? (int)cores : 1;
+}
+/******************************************************/
+static void run_worker(batch_shared *shared, int count, batch_task task, void *context, unsigned char *results, size_t result_size)
+{
+	while (true){
+		int index = atomic_fetch_add(&shared->next_task, 1);
+		if (index >= count) break;
+
+		unsigned char *result = results + (size_t)index * result_size;
+		pid_t child = fork();
+		if (child == 0){
+			task(index, result, context); // a fresh copy of this worker, whose robot program globals have never been touched
+			_exit(0);
+		}
+
+		int status = 0;
+		bool ok = child > 0 && waitpid(child, &status, 0) == child && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+		if (!ok){
+			memset(result, 0, result_size);
+			atomic_fetch_add(&shared->failed, 1);
+		}
+		atomic_fetch_add(&shared->finished, 1);
+	}
+}
+/******************************************************/
+int batch_run(int count, int jobs, batch_task task, void *context, void *results, size_t result_size, int progress)
+{
+	if (count <= 0) return 0;
+	if (jobs <= 0) jobs = batch_cores();
+	if (jobs > count) jobs = count;
+
+	// results are written by the task processes, so they live in shared memory until the batch is done
+	size_t results_bytes = (size_t)count * result_size;
+	void *memory = mmap(NULL, sizeof(batch_shared) + results_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED){
+		perror("batch_run: mmap");
+		return count;
+	}
+	batch_shared *shared = memory;
+	unsigned char *shared_results = (unsigned char *)memory + sizeof(batch_shared); // anonymous mappings start zeroed
+	atomic_init(&shared->next_task, 0);
+	atomic_init(&shared->finished, 0);
+	atomic_init(&shared->failed, 0);
+
+	fflush(NULL); // nothing buffered gets written twice by the children
+	int started = 0;
+	int i;
+	for (i = 0; i < jobs; i++){
+		pid_t worker = fork();
+		if (worker == 0){
+			run_worker(shared, count, task, context, shared_results, result_size);
+			_exit(0);
+		}
+		if (worker > 0) started++;
+	}
+	if (started == 0){
+		// could not fork at all.  Running the tasks here instead would run the robot program again on the state its last run left behind
+		perror("batch_run: fork");
+		munmap(memory, sizeof(batch_shared) + results_bytes);
+		return count;
+	}
+
+	int running = started;
+	while (running > 0){
+		if (progress){
+			fprintf(stderr, "\r%d/%d done", atomic_load(&shared->finished), count);
+			fflush(stderr);
+		}
+		while (running > 0 && waitpid(-1, NULL, WNOHANG) > 0) running--;
+		if (running > 0) usleep(200000);
+	}
+	if (progress) fprintf(stderr, "\r%d/%d done\n", atomic_load(&shared->finished), count);
+
+	int failed = atomic_load(&shared->failed) + (count - atomic_load(&shared->finished)); // tasks that never reported finished (the one a dying worker was running, or any left over if every worker died) count as failed too
+	memcpy(results, shared_results, results_bytes);
+	munmap(memory, sizeof(batch_shared) + results_bytes);
+	return failed;
+}
@@ -0,0 +1,152 @@
+/*
+Vassar Cognitive Science - Robot Ethology
+
+Microbenchmark harness, see include/bench.h.  Every suite (bench_gui.c, bench_plain.c, bench_camera.c) is linked with this
+file, which owns main() and the timing.
+
+	re_bench [-f filter] [-t seconds] [-c]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "bench.h"
+
+#define SAMPLES 5 // timed samples per benchmark, the median is reported
+
+volatile long bench_sink;
+
+static const char *filter = NULL; // only run benchmarks whose name contains this
+static double min_time = 0.5;	  // seconds all samples of one benchmark should take together
+static int csv = 0;				  // print CSV instead of a table
+static FILE *results;			  // the real standard output, the programs' own output goes to /dev/null
+
+// heap allocations made while a benchmark is timed, counted by the malloc() family below
+static int counting = 0;
+static unsigned long allocations = 0;
+
+//========================================//
+//===========ALLOCATION COUNTING==========//
+//========================================//
+
+// the malloc() family is replaced for the whole program so allocations made inside the C library (qsort, printf) are counted too.
+// the real allocator is glibc's, under its internal names
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *memory, size_t size);
+extern void __libc_free(void *memory);
+
+void *malloc(size_t size)
+{
+	if (counting) allocations++;
+	return __libc_malloc(size);
+}
+void *calloc(size_t count, size_t size)
+{
+	if (counting) allocations++;
+	return __libc_calloc(count, size);
+}
+void *realloc(void *memory, size_t size)
+{
+	if (counting) allocations++;
+	return __libc_realloc(memory, size);
+}
+void free(void *memory)
+{
+	__libc_free(memory);
+}
+
+//========================================//
+//=================TIMING=================//
+//========================================//
+
+static double wall_seconds()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now); // the real clock; the robot code under test sees the simulated one
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+/******************************************************/
+static int compare_doubles(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+/******************************************************/
+void bench_run(const char *name, bench_body body, void *context, double bytes)
+{
+	if (filter && !strstr(name, filter)) return;
+
+	// grow the count until one sample takes its share of min_time
+	long iterations = 1;
+	double target = min_time / SAMPLES, elapsed;
+	body(1, context); // warm up caches and anything the code sets up on its first call
+	for (;;){
+		double begin = wall_seconds();
+		body(iterations, context);
+		elapsed = wall_seconds() - begin;
+		if (elapsed >= target / 2 || iterations >= (1L << 40)) break;
+		iterations *= elapsed > 0 ? (target / elapsed > 100 ? 100 : 2) : 100;
+	}
+	if (elapsed > 0 && elapsed < target) iterations = (long)(iterations * target / elapsed) + 1;
+
+	double sample[SAMPLES];
+	unsigned long before = allocations;
+	counting = 1;
+	int i;
+	for (i = 0; i < SAMPLES; i++){
+		double begin = wall_seconds();
+		body(iterations, context);
+		sample[i] = wall_seconds() - begin;
+	}
+	counting = 0;
+	qsort(sample, SAMPLES, sizeof(double), compare_doubles);
+
+	double ns = sample[SAMPLES / 2] * 1e9 / iterations;
+	double allocs = (double)(allocations - before) / ((double)iterations * SAMPLES);
+	if (csv){
+		fprintf(results, "%s,%ld,%.2f,%.0f,%.1f,%.3f\n", name, iterations, ns, 1e9 / ns, bytes > 0 ? bytes * 1e3 / ns : 0, allocs);
+	}
+	else if (bytes > 0){
+		fprintf(results, "%-36s %12.1f ns/op %14.0f ops/s %10.1f MB/s %8.3f allocs/op\n", name, ns, 1e9 / ns, bytes * 1e3 / ns, allocs);
+	}
+	else{
+		fprintf(results, "%-36s %12.1f ns/op %14.0f ops/s %15s %8.3f allocs/op\n", name, ns, 1e9 / ns, "", allocs);
+	}
+	fflush(results);
+}
+
+//==================================//
+//===============MAIN===============//
+//==================================//
+
+int main(int argc, char *argv[])
+{
+	int option;
+	while ((option = getopt(argc, argv, "f:t:ch")) != -1){
+		switch (option){
+			case 'f': filter = optarg; break;
+			case 't': min_time = atof(optarg); break;
+			case 'c': csv = 1; break;
+			default:
+				fprintf(stderr, "usage: %s [-f filter] [-t seconds] [-c]\n", argv[0]);
+				fprintf(stderr, "  -f  only run the benchmarks whose name contains this\n");
+				fprintf(stderr, "  -t  seconds to spend timing each benchmark (default 0.5)\n");
+				fprintf(stderr, "  -c  print CSV: name,iterations,ns_per_op,ops_per_s,mb_per_s,allocs_per_op\n");
+				return option == 'h' ? 0 : 2;
+		}
+	}
+
+	// the code under test prints (RE_GUI's log events, printed on the spot without the logger thread), which would bury the results and time the terminal
+	results = fdopen(dup(STDOUT_FILENO), "w");
+	if (!results || !freopen("/dev/null", "w", stdout)){
+		perror("stdout");
+		return 1;
+	}
+	if (csv) fprintf(results, "name,iterations,ns_per_op,ops_per_s,mb_per_s,allocs_per_op\n");
+	run_benchmarks();
+	fclose(results);
+	return 0;
+}
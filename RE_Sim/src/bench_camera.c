@@ -0,0 +1,115 @@
+/*
+Vassar Cognitive Science - Robot Ethology
+
+Benchmark for frame_difference() in Kiss_Camera_Experiments/Camera_Experiments/Camera_Experiments.c at the camera resolutions
+in use, on two consecutive frames of the simulated camera.  Throughput is counted in bytes of camera frame compared.
+*/
+
+#include <stdio.h>
+#include <kipr/wombat.h> // the experiment leaves this to the KISS IDE
+
+#define main camera_main // the experiment's main() is never run here
+#include "../../Kiss_Camera_Experiments/Camera_Experiments/Camera_Experiments.c"
+#undef main
+
+#include "sim.h"
+#include "bench.h"
+
+// the two frames being compared, the two newest in the experiment's frame pool
+static const unsigned char *frame;
+static const unsigned char *previous;
+
+/******************************************************/
+static void difference_frames(long iterations, void *context)
+{
+	long n, sum = 0;
+	for (n = 0; n < iterations; n++) sum += frame_difference(frame, previous);
+	bench_sink = sum;
+}
+/******************************************************/
+static void difference_kernel(long iterations, void *context)
+{
+	// just the absolute difference and sum, without drawing anything
+	absdiff_kernel kernel = (absdiff_kernel)context;
+	long n;
+	unsigned long long sum = 0;
+	for (n = 0; n < iterations; n++) sum += kernel(frame, previous, diff_img, frame_bytes);
+	bench_sink = (long)sum;
+}
+/******************************************************/
+static void capture_and_difference(long iterations, void *context)
+{
+	// capture, difference and draw one after another, as the experiment did before the pipeline
+	long n, sum = 0;
+	for (n = 0; n < iterations; n++){
+		capture_frame();
+		sum += frame_difference(frame_history(0), frame_history(1));
+		graphics_update();
+	}
+	bench_sink = sum;
+}
+/******************************************************/
+static void pipeline_images_shown(long iterations, void *context)
+{
+	// the display stage of the running pipeline: every image it gets, however many frames were dropped on the way
+	long n, sum = 0;
+	for (n = 0; n < iterations; n++){
+		pipeline_image *image = next_image();
+		if (!image) break;
+		show_difference(image->pixels, frame_width, frame_height);
+		graphics_update();
+		sum += image->average_difference;
+		release_image(image);
+	}
+	bench_sink = sum;
+}
+/******************************************************/
+static bool capture_two_frames(int width, int height)
+{
+	// fill a fresh frame pool with two consecutive frames of the simulated camera
+	sim_camera_size(width, height);
+	if (!open_frame_pool(width, height)) return false;
+	capture_frame();
+	capture_frame();
+	frame = frame_history(0);
+	previous = frame_history(1);
+	return true;
+}
+/******************************************************/
+void bench_camera()
+{
+	static const struct { const char *name; int width, height; } sizes[] = {
+		{"frame_difference 160x120", 160, 120},
+		{"frame_difference 640x480", 640, 480},
+		{"frame_difference 1280x720", 1280, 720},
+	};
+	size_t i;
+	select_absdiff_kernel();
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++){
+		int bytes = sizes[i].width * sizes[i].height * 3;
+		if (!capture_two_frames(sizes[i].width, sizes[i].height)) return;
+		bench_run(sizes[i].name, difference_frames, NULL, bytes);
+		if (sizes[i].width != 640) continue;
+
+		// the kernel on its own, the scalar reference against the one select_absdiff_kernel() picked
+		char name[64];
+		bench_run("absdiff scalar 640x480", difference_kernel, (void *)absdiff_scalar, bytes);
+		snprintf(name, sizeof(name), "absdiff %s 640x480", absdiff_name);
+		if (absdiff_sum != absdiff_scalar) bench_run(name, difference_kernel, (void *)absdiff_sum, bytes);
+
+		// with the difference drawn four times smaller
+		preview_scale = 4;
+		if (!capture_two_frames(sizes[i].width, sizes[i].height)) return;
+		bench_run("frame_difference 640x480 preview/4", difference_frames, NULL, bytes);
+		preview_scale = 1;
+
+		// a whole frame from the camera to the screen, sequential and pipelined
+		if (!capture_two_frames(sizes[i].width, sizes[i].height)) return;
+		bench_run("capture+difference 640x480", capture_and_difference, NULL, bytes);
+		if (!start_pipeline()) return;
+		bench_run("pipeline 640x480", pipeline_images_shown, NULL, bytes);
+		stop_pipeline();
+	}
+	close_frame_pool();
+	camera_close();
+}
@@ -0,0 +1,144 @@
+/*
+Vassar Cognitive Science - Robot Ethology
+
+Benchmarks for RE_GUI/src/main.c: sensor reads, arbitration over the subsumption hierarchy, the motor command helpers and the
+re-rank qsort() of update_gui().  The program is included whole, so its functions are timed exactly as the robot builds them.
+*/
+
+#define main robot_main // the program's main() is never run here
+#include "../../RE_GUI/src/main.c"
+#undef main
+
+#include <string.h>
+#include "sim.h"
+#include "bench.h"
+
+#define SHUFFLES 16 // different hierarchy orders the qsort benchmark cycles through
+
+// snapshots that make the hierarchy settle at different depths: only the cruise behaviors fire, the photo differential fires, a front bumper is pressed
+static sensor_snapshot scenes[3];
+static behavior shuffles[SHUFFLES][sizeof(subsumption_hierarchy) / sizeof(behavior)];
+
+/******************************************************/
+static void read_all_sensors(long iterations, void *context)
+{
+	sensor_snapshot snapshot = {0};
+	long n;
+	for (n = 0; n < iterations; n++){
+		snapshot.sensors_read = 0; // nothing held yet, so every group is read
+		read_sensor_groups(&snapshot, ALL_SENSORS);
+	}
+	bench_sink = snapshot.right_photo;
+}
+/******************************************************/
+static void select_on_scenes(long iterations, void *context)
+{
+	long n, winners = 0;
+	for (n = 0; n < iterations; n++) winners += select_behavior(&scenes[n % 3], false, ~0u);
+	bench_sink = winners;
+}
+/******************************************************/
+static void arbitrate_on_scenes(long iterations, void *context)
+{
+	long n;
+	for (n = 0; n < iterations; n++){
+		arbitrate(&scenes[n % 3], false);
+		pending_action.length = 0; // as commit_motor_command() would, without talking to the servos
+	}
+	bench_sink = tick_winner;
+}
+/******************************************************/
+static void arbitrate_with_reads(long iterations, void *context)
+{
+	// a whole operating tick's decision: start from an empty snapshot and read only the sensor groups arbitration gets to
+	sensor_snapshot snapshot = {0};
+	long n;
+	for (n = 0; n < iterations; n++){
+		snapshot.sensors_read = 0;
+		arbitrate(&snapshot, true);
+		pending_action.length = 0;
+	}
+	bench_sink = tick_winner;
+}
+/******************************************************/
+static void drive_commands(long iterations, void *context)
+{
+	long n, positions = 0;
+	for (n = 0; n < iterations; n++){
+		drive((n & 15) / 16.0f, -(n & 7) / 8.0f, 0.1f);
+		positions += pending_action.phases[0].left_position;
+		pending_action.length = 0;
+	}
+	bench_sink = positions;
+}
+/******************************************************/
+static void map_values(long iterations, void *context)
+{
+	float sum = 0;
+	long n;
+	for (n = 0; n < iterations; n++) sum += map((n & 255) / 128.0f - 1, -1.0, 1.0, 0, 2047);
+	bench_sink = (long)sum;
+}
+/******************************************************/
+static void rerank_hierarchy(long iterations, void *context)
+{
+	// what update_gui() does after a button press: sort the whole hierarchy by activity and rank.  Includes copying the shuffled order in
+	behavior order[sizeof(subsumption_hierarchy) / sizeof(behavior)];
+	long n;
+	for (n = 0; n < iterations; n++){
+		memcpy(order, shuffles[n % SHUFFLES], sizeof(order));
+		qsort(order, hierarchy_length, sizeof(behavior), compare_ranks);
+	}
+	bench_sink = order[0].type;
+}
+/******************************************************/
+static void record_latencies(long iterations, void *context)
+{
+	// what the latency histograms add to every stage of a tick: one clock read and one histogram update
+	long n;
+	for (n = 0; n < iterations; n++) record_stage(SENSOR_STAGE, stage_clock() - (n & 4095));
+	bench_sink = latency_histograms[SENSOR_STAGE].count;
+}
+/******************************************************/
+void run_benchmarks()
+{
+	sim_config config;
+	sim_default_config(&config);
+	config.duration = 1e9; // heavy polling moves the simulated clock on, make sure it never runs out
+	config.sensor_noise = 0; // time the program, not the noise model
+	sim_reset(&config);
+	use_logger_thread = true; // seek light logs, and on the robot that is only a queue push (the queue fills up and drops here)
+
+	// every behavior active, in the boot order
+	size_t i, j;
+	for (i = 0; i < hierarchy_length; i++){
+		subsumption_hierarchy[i].is_active = true;
+		subsumption_hierarchy[i].rank = i;
+	}
+	compile_hierarchy();
+
+	for (i = 0; i < 3; i++){
+		scenes[i] = (sensor_snapshot){.right_photo = 2000, .left_photo = 2000, .right_ir = 500, .left_ir = 500, .sensors_read = ALL_SENSORS};
+	}
+	scenes[1].left_photo = 1000;
+	scenes[2].bumps = FRONT_BUMP_LEFT_BIT;
+
+	srand(1);
+	for (i = 0; i < SHUFFLES; i++){
+		memcpy(shuffles[i], subsumption_hierarchy, sizeof(shuffles[i]));
+		for (j = 0; j < hierarchy_length; j++){
+			shuffles[i][j].rank = rand() % 100;
+			shuffles[i][j].is_active = rand() % 2;
+		}
+	}
+
+	bench_run("read_sensor_groups(ALL_SENSORS)", read_all_sensors, NULL, 0);
+	bench_run("select_behavior", select_on_scenes, NULL, 0);
+	bench_run("arbitrate", arbitrate_on_scenes, NULL, 0);
+	bench_run("arbitrate with sensor reads", arbitrate_with_reads, NULL, 0);
+	bench_run("drive", drive_commands, NULL, 0);
+	bench_run("map", map_values, NULL, 0);
+	bench_run("qsort(compare_ranks)", rerank_hierarchy, NULL, sizeof(subsumption_hierarchy));
+	bench_run("record_stage", record_latencies, NULL, 0);
+	bench_camera();
+}
@@ -0,0 +1,101 @@
+/*
+Vassar Cognitive Science - Robot Ethology
+
+Benchmarks for RE_Plain/src/main.c, the same hot paths as bench_gui.c so the two programs can be compared.
+*/
+
+#define main robot_main // the program's main() is never run here
+#include "../../RE_Plain/src/main.c"
+#undef main
+
+#include <string.h>
+#include "sim.h"
+#include "bench.h"
+
+#define SHUFFLES 16 // different hierarchy orders the qsort benchmark cycles through
+
+static behavior shuffles[SHUFFLES][sizeof(subsumption_hierarchy) / sizeof(behavior)];
+
+/******************************************************/
+static void read_all_sensors(long iterations, void *context)
+{
+	long n;
+	for (n = 0; n < iterations; n++) read_sensors();
+	bench_sink = right_photo_value;
+}
+/******************************************************/
+static void decide_on_readings(long iterations, void *context)
+{
+	// the if/else chain and the action it picks, on whatever the sensors read last
+	long n, winners = 0;
+	for (n = 0; n < iterations; n++) winners += decide();
+	bench_sink = winners;
+}
+/******************************************************/
+static void read_and_decide(long iterations, void *context)
+{
+	long n, winners = 0;
+	for (n = 0; n < iterations; n++){
+		read_sensors();
+		winners += decide();
+	}
+	bench_sink = winners;
+}
+/******************************************************/
+static void drive_commands(long iterations, void *context)
+{
+	long n, durations = 0;
+	for (n = 0; n < iterations; n++){
+		drive((n & 15) / 16.0f, -(n & 7) / 8.0f, 0.1f);
+		durations += timer_duration;
+	}
+	bench_sink = durations;
+}
+/******************************************************/
+static void map_values(long iterations, void *context)
+{
+	float sum = 0;
+	long n;
+	for (n = 0; n < iterations; n++) sum += map((n & 255) / 128.0f - 1, -1.0, 1.0, 0, 2047);
+	bench_sink = (long)sum;
+}
+/******************************************************/
+static void rerank_hierarchy(long iterations, void *context)
+{
+	behavior order[sizeof(subsumption_hierarchy) / sizeof(behavior)];
+	long n;
+	for (n = 0; n < iterations; n++){
+		memcpy(order, shuffles[n % SHUFFLES], sizeof(order));
+		qsort(order, hierarchy_length, sizeof(behavior), compare_ranks);
+	}
+	bench_sink = order[0].type;
+}
+/******************************************************/
+void run_benchmarks()
+{
+	sim_config config;
+	sim_default_config(&config);
+	config.duration = 1e9; // heavy polling moves the simulated clock on, make sure it never runs out
+	config.sensor_noise = 0; // time the program, not the noise model
+	sim_reset(&config);
+	hierarchy_length = sizeof(subsumption_hierarchy) / sizeof(behavior); // as main() sets it
+
+	size_t i, j;
+	srand(1);
+	for (i = 0; i < SHUFFLES; i++){
+		memcpy(shuffles[i], subsumption_hierarchy, sizeof(shuffles[i]));
+		for (j = 0; j < hierarchy_length; j++){
+			shuffles[i][j].rank = rand() % 100;
+			shuffles[i][j].is_active = rand() % 2;
+		}
+	}
+	read_sensors();
+
+	bench_run("read_sensors", read_all_sensors, NULL, 0);
+	bench_run("decide", decide_on_readings, NULL, 0);
+	bench_run("read_sensors + decide", read_and_decide, NULL, 0);
+	bench_run("drive", drive_commands, NULL, 0);
+	bench_run("map", map_values, NULL, 0);
+	bench_run("qsort(compare_ranks)", rerank_hierarchy, NULL, sizeof(subsumption_hierarchy));
+	bench_camera();
+}
@@ -0,0 +1,276 @@
+/*
+Vassar Cognitive Science - Robot Ethology
+
+Hierarchy search: enumerates every ordered subset of RE_GUI's behaviors as a subsumption hierarchy, runs each one in the simulator
+on every core, and ranks them.
+
+	re_hierarchies [-t seconds] [-r runs] [-k penalty] [-n top] [-p name=value] [-c csv]
+
+With 9 behaviors there are 986409 ordered subsets, but most of them behave exactly like a shorter one because a behavior ranked
+below another that always fires whenever it does can never run, or never fires at all.  Those are skipped, since the shorter hierarchy
+is enumerated anyway:
+	- nothing ranked below CRUISE STRAIGHT or CRUISE ARC, which fire on every tick
+	- not both SEEK LIGHT and SEEK DARK, which share the photo differential trigger
+	- not both AVOID and APPROACH while their thresholds are equal, which makes their triggers the same
+	- not MOTION, which never fires in the simulator: threads are not simulated, so there is no vision thread to see anything move
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "sim.h"
+#include "batch.h"
+#include "robot.h"
+
+#define MAX_BEHAVIORS 16
+
+int robot_main(); // RE_GUI's main(), renamed when it was compiled for the simulator
+
+// *** Define a candidate hierarchy: behavior indexes into subsumption_hierarchy, highest ranked first *** //
+typedef struct candidate{
+	unsigned char behaviors[MAX_BEHAVIORS];
+	unsigned char length;
+} candidate;
+
+// *** Define what one run reports back *** //
+typedef struct run_result{
+	float collisions, time_near_light, distance;
+	int completed; // stays 0 if the run's process crashed
+} run_result;
+
+// *** Define a ranked hierarchy *** //
+typedef struct ranking{
+	int candidate;
+	float score, collisions, time_near_light, distance;
+	int failed_runs;
+} ranking;
+
+// *** Define everything a run needs to know *** //
+typedef struct search{
+	candidate *candidates;
+	int candidate_count;
+	int capacity;
+	int runs;
+	sim_config config;
+} search;
+
+/******************************************************/
+bool always_fires_with(int upper, int lower)
+{
+	// true if behavior type upper fires on every tick that type lower does, so lower can never run below it
+	if (upper == CRUISE_S_TYPE || upper == CRUISE_A_TYPE) return true;
+	if ((upper == SEEK_LIGHT_TYPE && lower == SEEK_DARK_TYPE) || (upper == SEEK_DARK_TYPE && lower == SEEK_LIGHT_TYPE)) return true;
+	if ((upper == AVOID_TYPE && lower == APPROACH_TYPE) || (upper == APPROACH_TYPE && lower == AVOID_TYPE)){
+		return avoid_threshold == approach_threshold;
+	}
+	return false;
+}
+/******************************************************/
+bool never_fires(int type)
+{
+	return type == MOTION_TYPE;
+}
+/******************************************************/
+void add_candidate(search *s, const candidate *c)
+{
+	if (s->candidate_count == s->capacity){
+		s->capacity = s->capacity ? 2 * s->capacity : 1024;
+		s->candidates = realloc(s->candidates, s->capacity * sizeof(candidate));
+		if (!s->candidates){
+			fprintf(stderr, "out of memory\n");
+			exit(1);
+		}
+	}
+	s->candidates[s->candidate_count++] = *c;
+}
+/******************************************************/
+void enumerate(search *s, candidate *c, unsigned int used, int *total)
+{
+	// extend c by every behavior not used yet, depth first, leaving out extensions that could never run
+	int i, j;
+	for (i = 0; i < hierarchy_length && i < MAX_BEHAVIORS; i++){
+		if (used & (1u << i)) continue;
+		(*total)++; // counted before pruning, for the report
+
+		bool reachable = !never_fires(subsumption_hierarchy[i].type);
+		for (j = 0; j < c->length && reachable; j++){
+			reachable = !always_fires_with(subsumption_hierarchy[c->behaviors[j]].type, subsumption_hierarchy[i].type);
+		}
+		if (!reachable){
+			// this behavior is dead here, and so is it anywhere further down: skip the count of everything below it
+			int remaining = 0, k, n;
+			for (k = 0; k < hierarchy_length && k < MAX_BEHAVIORS; k++) if (!(used & (1u << k)) && k != i) remaining++;
+			int below = 0, ways = 1;
+			for (n = 1; n <= remaining; n++){
+				ways *= remaining - n + 1;
+				below += ways;
+			}
+			*total += below;
+			continue;
+		}
+
+		c->behaviors[c->length++] = i;
+		add_candidate(s, c);
+		enumerate(s, c, used | (1u << i), total);
+		c->length--;
+	}
+}
+/******************************************************/
+void run_candidate(int index, void *result, void *context)
+{
+	const search *s = context;
+	const candidate *c = &s->candidates[index / s->runs];
+	int order[MAX_BEHAVIORS], i;
+	for (i = 0; i < c->length; i++) order[i] = c->behaviors[i];
+	set_hierarchy_order(order, c->length);
+
+	sim_config config = s->config;
+	config.seed = index % s->runs + 1;
+	sim_metrics metrics;
+	sim_run(&config, robot_main, &metrics);
+
+	run_result *r = result;
+	r->collisions = metrics.collisions;
+	r->time_near_light = metrics.time_near_light;
+	r->distance = metrics.distance;
+	r->completed = 1;
+}
+/******************************************************/
+int compare_scores(const void *a, const void *b)
+{
+	const ranking *x = a, *y = b;
+	if (x->score != y->score) return x->score < y->score ? 1 : -1; // best first
+	return x->candidate - y->candidate; // ties keep enumeration order, so the report is the same on every machine
+}
+/******************************************************/
+void print_hierarchy(FILE *out, const candidate *c, const char *separator)
+{
+	int i;
+	for (i = 0; i < c->length; i++) fprintf(out, "%s%s", i ? separator : "", subsumption_hierarchy[c->behaviors[i]].title);
+}
+/******************************************************/
+void print_usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-t seconds] [-r runs] [-k penalty] [-n top] [-p name=value] [-j jobs] [-c csv]\n", name);
+	fprintf(stderr, "  -t  simulated seconds per run (default 120)\n");
+	fprintf(stderr, "  -r  runs per hierarchy, with seeds 1 to runs (default 2)\n");
+	fprintf(stderr, "  -k  seconds near the light a collision costs in the score (default 5)\n");
+	fprintf(stderr, "  -n  hierarchies to list (default 20)\n");
+	fprintf(stderr, "  -p  set a threshold or action tuning value for every run, see re_sweep -l\n");
+	fprintf(stderr, "  -o  obstacles in the arena (default 4)\n");
+	fprintf(stderr, "  -j  processes to run at once (default one per core)\n");
+	fprintf(stderr, "  -c  write every hierarchy's results as CSV to this file\n");
+}
+/******************************************************/
+int main(int argc, char *argv[])
+{
+	static search s; // shared read only with every run process
+	sim_default_config(&s.config);
+	s.config.duration = 120;
+	s.runs = 2;
+	double penalty = 5;
+	int top = 20, jobs = 0;
+	const char *csv_path = NULL;
+
+	int option, i;
+	while ((option = getopt(argc, argv, "t:r:k:n:p:o:j:c:h")) != -1){
+		switch (option){
+			case 't': s.config.duration = atof(optarg); break;
+			case 'r': s.runs = atoi(optarg); break;
+			case 'k': penalty = atof(optarg); break;
+			case 'n': top = atoi(optarg); break;
+			case 'p':{
+				char name[64];
+				double value;
+				const robot_tunable *tunable = NULL;
+				if (sscanf(optarg, "%63[^=]=%lf", name, &value) == 2) tunable = find_tunable(name);
+				if (!tunable){
+					fprintf(stderr, "expected name=value with a name from re_sweep -l, got \"%s\"\n", optarg);
+					return 2;
+				}
+				set_tunable(tunable, value); // set once here, every run process inherits it
+				break;
+			}
+			case 'o': s.config.obstacle_count = atoi(optarg); break;
+			case 'j': jobs = atoi(optarg); break;
+			case 'c': csv_path = optarg; break;
+			default:
+				print_usage(argv[0]);
+				return option == 'h' ? 0 : 2;
+		}
+	}
+	if (s.runs < 1) s.runs = 1;
+
+	candidate empty = {{0}, 0};
+	int total = 0;
+	enumerate(&s, &empty, 0, &total);
+	fprintf(stderr, "%d ordered hierarchies, %d left after pruning; %d runs of %.0f simulated seconds on %d processes\n", total,
+		s.candidate_count, s.candidate_count * s.runs, s.config.duration, jobs > 0 ? jobs : batch_cores());
+
+	int task_count = s.candidate_count * s.runs;
+	run_result *runs = calloc(task_count, sizeof(run_result));
+	ranking *rankings = calloc(s.candidate_count, sizeof(ranking));
+	if (!runs || !rankings){
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+	int failed = batch_run(task_count, jobs, run_candidate, &s, runs, sizeof(run_result), isatty(STDERR_FILENO));
+	if (failed) fprintf(stderr, "%d runs failed\n", failed);
+
+	for (i = 0; i < s.candidate_count; i++){
+		ranking *r = &rankings[i];
+		r->candidate = i;
+		int run, completed = 0;
+		for (run = 0; run < s.runs; run++){
+			const run_result *result = &runs[i * s.runs + run];
+			if (!result->completed){
+				r->failed_runs++;
+				continue;
+			}
+			r->collisions += result->collisions;
+			r->time_near_light += result->time_near_light;
+			r->distance += result->distance;
+			completed++;
+		}
+		if (completed){
+			r->collisions /= completed;
+			r->time_near_light /= completed;
+			r->distance /= completed;
+			r->score = r->time_near_light - penalty * r->collisions;
+		}
+		else{
+			r->score = -1e30; // never ran, rank it last
+		}
+	}
+	qsort(rankings, s.candidate_count, sizeof(ranking), compare_scores);
+
+	printf("rank   score  near light  collisions  distance  hierarchy\n");
+	for (i = 0; i < s.candidate_count && i < top; i++){
+		const ranking *r = &rankings[i];
+		printf("%4d %7.1f %10.1fs %11.1f %8.2fm  ", i + 1, r->score, r->time_near_light, r->collisions, r->distance);
+		print_hierarchy(stdout, &s.candidates[r->candidate], " > ");
+		printf("\n");
+	}
+
+	if (csv_path){
+		FILE *csv = fopen(csv_path, "w");
+		if (!csv){
+			perror(csv_path);
+			return 1;
+		}
+		fprintf(csv, "rank,score,time_near_light,collisions,distance,failed_runs,hierarchy\n");
+		for (i = 0; i < s.candidate_count; i++){
+			const ranking *r = &rankings[i];
+			fprintf(csv, "%d,%g,%g,%g,%g,%d,\"", i + 1, r->score, r->time_near_light, r->collisions, r->distance, r->failed_runs);
+			print_hierarchy(csv, &s.candidates[r->candidate], ";");
+			fprintf(csv, "\"\n");
+		}
+		fclose(csv);
+	}
+
+	free(runs);
+	free(rankings);
+	free(s.candidates);
+	return failed ? 1 : 0;
+}
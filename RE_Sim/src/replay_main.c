@@ -0,0 +1,88 @@
+/*
+Vassar Cognitive Science - Robot Ethology
+
+Replay driver: runs a robot program against a recorded telemetry file and writes down every decision it makes, as CSV:
+
+	time_ms,behavior,title,left_position,right_position
+
+one line per tick on which the program chose a behavior, with the servo positions that choice left on the motors.  Replaying the
+same trace through two versions of a program and diffing the output shows exactly where their decisions part ways.
+
+	re_replay re_telemetry.bin > decisions.csv			(RE_GUI)
+	re_replay_plain re_telemetry.bin > decisions.csv	(RE_Plain)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <kipr/wombat.h>
+#include "sim.h"
+#include "replay.h"
+
+int robot_main();		 // the robot program's main(), renamed when it was compiled for the simulator
+extern int tick_winner; // type of the behavior the program chose this tick, -1 if it chose nothing
+
+// behavior titles by type key, as in the programs' subsumption_hierarchy
+static const char *behavior_titles[] = {"SEEK LIGHT", "SEEK DARK", "APPROACH", "AVOID", "ESCAPE FRONT", "ESCAPE BACK", "CRUISE STRAIGHT", "CRUISE ARC", "MOTION"};
+
+static FILE *decisions;
+static sim_config config;
+static unsigned long ticks, decision_count;
+
+/******************************************************/
+void record_decision()
+{
+	// the programs sleep once per tick, after committing that tick's motor command, so this sees every tick's decision exactly once
+	ticks++;
+	if (tick_winner == -1) return;
+	const char *title = tick_winner == -2 ? "STOP" : tick_winner >= 0 && tick_winner < (int)(sizeof(behavior_titles) / sizeof(behavior_titles[0])) ? behavior_titles[tick_winner] : "?";
+	fprintf(decisions, "%lu,%d,%s,%d,%d\n", systime(), tick_winner, title, get_servo_position(config.wiring.left_motor_pin),
+		get_servo_position(config.wiring.right_motor_pin));
+	decision_count++;
+	tick_winner = -1; // a tick that doesn't decide anything (like one in the menu) must not repeat this decision
+}
+/******************************************************/
+int main(int argc, char *argv[])
+{
+	const char *output_path = NULL;
+	sim_default_config(&config);
+	config.sensor_noise = 0;
+
+	int option;
+	while ((option = getopt(argc, argv, "o:T:vh")) != -1){
+		switch (option){
+			case 'o': output_path = optarg; break;
+			case 'T': config.telemetry_path = optarg; break;
+			case 'v': config.show_output = true; break;
+			default:
+				fprintf(stderr, "usage: %s [-o decisions.csv] [-T telemetry] [-v] trace\n", argv[0]);
+				fprintf(stderr, "  -o  write the decisions here instead of to standard output\n");
+				fprintf(stderr, "  -T  also let RE_GUI write the telemetry of the replayed run to this file\n");
+				fprintf(stderr, "  -v  show the robot program's own output (mixed in with the decisions unless -o is given)\n");
+				return option == 'h' ? 0 : 2;
+		}
+	}
+	if (optind != argc - 1){
+		fprintf(stderr, "usage: %s [-o decisions.csv] [-T telemetry] [-v] trace\n", argv[0]);
+		return 2;
+	}
+	if (!replay_open(argv[optind])) return 1;
+
+	// the program's own output is sent to /dev/null during the run, so keep a separate handle on the real standard output
+	decisions = output_path ? fopen(output_path, "w") : fdopen(dup(STDOUT_FILENO), "w");
+	if (!decisions){
+		perror(output_path ? output_path : "stdout");
+		return 1;
+	}
+	fprintf(decisions, "time_ms,behavior,title,left_position,right_position\n");
+
+	config.duration = replay_seconds() + 0.001; // stop at the last recorded tick
+	sim_tick_hook = record_decision;
+	sim_metrics metrics;
+	sim_run(&config, robot_main, &metrics);
+	fclose(decisions);
+
+	fprintf(stderr, "replayed %.1f s (%llu recorded ticks) as %lu ticks and %lu decisions in %.3f s, %.2f million ticks/s\n", metrics.sim_seconds,
+		replay_ticks(), ticks, decision_count, metrics.wall_seconds, metrics.wall_seconds > 0 ? ticks / metrics.wall_seconds / 1e6 : 0);
+	return 0;
+}
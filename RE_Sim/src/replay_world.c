@@ -0,0 +1,162 @@
+/*
+Vassar Cognitive Science - Robot Ethology
+
+World model that plays back a telemetry file instead of simulating anything, see include/replay.h.
+
+The trace is memory mapped and walked in time order as the virtual clock advances.  A record only updates the sensor groups the
+robot actually read on that tick (sensors_read); the values of the other groups are left over in the record and are ignored, so a
+replayed program always sees the latest real reading of every sensor.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sim.h"
+#include "replay.h"
+#include "telemetry.h"
+
+// sensor groups of a telemetry record's sensors_read, the same as the *_SENSORS defines in RE_GUI/src/main.c
+#define PHOTO_SENSORS 0x01
+#define IR_SENSORS 0x02
+#define FRONT_BUMP_SENSORS 0x04
+#define BACK_BUMP_SENSORS 0x08
+#define VISION_SENSORS 0x10
+#define FRONT_BUMP_BITS (SIM_BUMP_FRONT_LEFT | SIM_BUMP_FRONT_CENTER | SIM_BUMP_FRONT_RIGHT)
+
+static const telemetry_header *trace = NULL;
+static const telemetry_record *records;
+static unsigned long long first, count; // the records still in the ring, oldest first
+static unsigned long long next_record;	// the next record to apply
+static unsigned long long elapsed;		// microseconds since the start of the trace, counted exactly so a tick never misses the record taken at the same time
+
+// the latest reading of every sensor
+static int right_photo, left_photo, right_ir, left_ir;
+static unsigned char bumps;
+
+void replay_motion(int left, int right) __attribute__((weak)); // NULL unless the program's glue is linked in
+
+/******************************************************/
+static const telemetry_record *record_at(unsigned long long n)
+{
+	return &records[n % trace->capacity];
+}
+/******************************************************/
+static unsigned long long record_time(unsigned long long n)
+{
+	return record_at(n)->timestamp - record_at(first)->timestamp;
+}
+/******************************************************/
+static void apply_records()
+{
+	// bring the sensors up to date with every record at or before the current time
+	while (next_record < count && record_time(next_record) <= elapsed){
+		const telemetry_record *r = record_at(next_record++);
+		if (r->sensors_read & PHOTO_SENSORS){
+			right_photo = r->right_photo;
+			left_photo = r->left_photo;
+		}
+		if (r->sensors_read & IR_SENSORS){
+			right_ir = r->right_ir;
+			left_ir = r->left_ir;
+		}
+		if (r->sensors_read & FRONT_BUMP_SENSORS) bumps = (bumps & ~FRONT_BUMP_BITS) | (r->bumps & FRONT_BUMP_BITS);
+		if (r->sensors_read & BACK_BUMP_SENSORS) bumps = (bumps & FRONT_BUMP_BITS) | (r->bumps & ~FRONT_BUMP_BITS);
+		if ((r->sensors_read & VISION_SENSORS) && replay_motion) replay_motion(r->left_motion, r->right_motion);
+	}
+}
+/******************************************************/
+bool replay_open(const char *path)
+{
+	int file = open(path, O_RDONLY);
+	struct stat info;
+	if (file < 0 || fstat(file, &info) != 0){
+		perror(path);
+		if (file >= 0) close(file);
+		return false;
+	}
+	const void *memory = (size_t)info.st_size >= sizeof(telemetry_header) ? mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED;
+	close(file);
+	if (memory == MAP_FAILED){
+		fprintf(stderr, "%s: not a telemetry file\n", path);
+		return false;
+	}
+
+	const telemetry_header *header = memory;
+	if (memcmp(header->magic, TELEMETRY_MAGIC, sizeof(header->magic)) != 0 || header->version != TELEMETRY_VERSION
+		|| header->record_size != sizeof(telemetry_record) || header->capacity == 0
+		|| sizeof(telemetry_header) + (size_t)header->capacity * sizeof(telemetry_record) > (size_t)info.st_size){
+		fprintf(stderr, "%s: not a version %d telemetry file\n", path, TELEMETRY_VERSION);
+		munmap((void *)memory, info.st_size);
+		return false;
+	}
+	if (header->record_count == 0){
+		fprintf(stderr, "%s: no ticks recorded\n", path);
+		munmap((void *)memory, info.st_size);
+		return false;
+	}
+
+	madvise((void *)memory, info.st_size, MADV_SEQUENTIAL); // read once, front to back (wrapping once)
+	trace = header;
+	records = (const telemetry_record *)(header + 1);
+	count = header->record_count;
+	first = count > header->capacity ? count - header->capacity : 0;
+	return true;
+}
+/******************************************************/
+double replay_seconds()
+{
+	return trace ? record_time(count - 1) / 1e6 : 0;
+}
+/******************************************************/
+unsigned long long replay_ticks()
+{
+	return trace ? count - first : 0;
+}
+/******************************************************/
+void world_reset(const sim_config *config)
+{
+	(void)config; // the trace is the whole world
+	next_record = first;
+	elapsed = 0;
+	right_photo = left_photo = right_ir = left_ir = 0;
+	bumps = 0;
+	if (replay_motion) replay_motion(0, 0);
+	if (trace) apply_records();
+}
+/******************************************************/
+void world_step(double dt, double left_speed, double right_speed)
+{
+	(void)left_speed; // what the program does cannot change what was recorded
+	(void)right_speed;
+	elapsed += (unsigned long long)(dt * 1e6 + 0.5);
+	if (trace) apply_records();
+}
+/******************************************************/
+double world_ir(bool left)
+{
+	return left ? left_ir : right_ir;
+}
+/******************************************************/
+double world_photo(bool left)
+{
+	return left ? left_photo : right_photo;
+}
+/******************************************************/
+unsigned char world_bumps()
+{
+	return bumps;
+}
+/******************************************************/
+double world_gaussian()
+{
+	return 0; // recorded readings already carry their own noise
+}
+/******************************************************/
+void world_metrics(sim_metrics *metrics)
+{
+	memset(metrics, 0, sizeof(*metrics));
+	metrics->sim_seconds = elapsed / 1e6;
+}
@@ -0,0 +1,117 @@
+/*
+Vassar Cognitive Science - Robot Ethology
+
+RE_GUI specific glue: the switches the simulator turns off for every run, the motion scores a replay feeds back, and setters for
+the globals the batch tools vary, see include/robot.h.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+#include "robot.h"
+#include "replay.h"
+
+#define MAX_BEHAVIORS 32
+
+const robot_tunable robot_tunables[] = {
+	{"avoid_threshold", &avoid_threshold, NULL},
+	{"approach_threshold", &approach_threshold, NULL},
+	{"photo_threshold", &photo_threshold, NULL},
+	{"cruise_speed", NULL, &cruise_speed},
+	{"cruise_time", NULL, &cruise_time},
+	{"avoid_turn_speed", NULL, &avoid_turn_speed},
+	{"avoid_turn_time", NULL, &avoid_turn_time},
+	{"seek_turn_speed", NULL, &seek_turn_speed},
+	{"seek_turn_time", NULL, &seek_turn_time}
+};
+const int robot_tunable_count = sizeof(robot_tunables) / sizeof(robot_tunable);
+
+/******************************************************/
+void sim_program_reset(const sim_config *config)
+{
+	// threads are not simulated, so RE_GUI samples, logs and (not) watches the camera on the control loop
+	use_sensor_thread = false;
+	use_logger_thread = false; // log events are printed straight away
+	use_vision = false;		   // the motion scores stay 0
+	use_telemetry = config->telemetry_path != NULL; // batch runs would otherwise all write the same file
+	if (config->telemetry_path) telemetry_path = config->telemetry_path;
+	use_profiles = false;	   // every run starts from the program's own hierarchy
+}
+/******************************************************/
+void replay_motion(int left, int right)
+{
+	// stand in for the vision thread, publishing the scores the robot recorded the way watch_motion() publishes its own
+	atomic_store_explicit(&motion_scores, (unsigned int)left << 16 | (unsigned int)right, memory_order_relaxed);
+}
+/******************************************************/
+const robot_tunable *find_tunable(const char *name)
+{
+	int i;
+	for (i = 0; i < robot_tunable_count; i++){
+		if (strcmp(robot_tunables[i].name, name) == 0) return &robot_tunables[i];
+	}
+	return NULL;
+}
+/******************************************************/
+double get_tunable(const robot_tunable *tunable)
+{
+	return tunable->int_value ? *tunable->int_value : *tunable->float_value;
+}
+/******************************************************/
+void set_tunable(const robot_tunable *tunable, double value)
+{
+	if (tunable->int_value) *tunable->int_value = (int)(value < 0 ? value - 0.5 : value + 0.5); // round, steps like 0.1 don't land exactly on integers
+	else *tunable->float_value = (float)value;
+}
+/******************************************************/
+void set_hierarchy_order(const int *indexes, int count)
+{
+	// active behaviors first, in the order given, then everything else inactive; compile_hierarchy() only looks at that order
+	behavior original[MAX_BEHAVIORS];
+	bool used[MAX_BEHAVIORS] = {false};
+	int length = hierarchy_length < MAX_BEHAVIORS ? hierarchy_length : MAX_BEHAVIORS;
+	memcpy(original, subsumption_hierarchy, length * sizeof(behavior));
+
+	int filled = 0, i;
+	for (i = 0; i < count; i++){
+		subsumption_hierarchy[filled] = original[indexes[i]];
+		subsumption_hierarchy[filled].is_active = true;
+		used[indexes[i]] = true;
+		filled++;
+	}
+	for (i = 0; i < length; i++){
+		if (used[i]) continue;
+		subsumption_hierarchy[filled] = original[i];
+		subsumption_hierarchy[filled].is_active = false;
+		filled++;
+	}
+	for (i = 0; i < length; i++) subsumption_hierarchy[i].rank = i;
+}
+/******************************************************/
+bool set_hierarchy(const char *titles)
+{
+	int indexes[MAX_BEHAVIORS];
+	int count = 0;
+	const char *start = titles;
+	while (*start){
+		const char *end = strchr(start, ',');
+		size_t length = end ? (size_t)(end - start) : strlen(start);
+
+		int found = -1, i;
+		for (i = 0; i < hierarchy_length; i++){
+			if (strlen(subsumption_hierarchy[i].title) == length && strncmp(subsumption_hierarchy[i].title, start, length) == 0) found = i;
+		}
+		for (i = 0; found >= 0 && i < count; i++){
+			if (indexes[i] == found) found = -2;
+		}
+		if (found < 0){
+			fprintf(stderr, "%s behavior \"%.*s\"\n", found == -1 ? "unknown" : "repeated", (int)length, start);
+			return false;
+		}
+		indexes[count++] = found;
+		start = end ? end + 1 : start + length;
+	}
+	set_hierarchy_order(indexes, count);
+	return true;
+}
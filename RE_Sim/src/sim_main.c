@@ -0,0 +1,60 @@
+/*
+Vassar Cognitive Science - Robot Ethology
+
+Command line front end for the headless simulator: runs one robot program in a simulated arena, faster than real time, and reports
+what it did.
+
+	re_sim [-t seconds] [-s seed] [-o obstacles] [-n noise] [-T telemetry] [-v]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "sim.h"
+
+int robot_main(); // the robot program's main(), renamed when it was compiled for the simulator
+
+/******************************************************/
+void print_usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-t seconds] [-s seed] [-o obstacles] [-n noise] [-T telemetry] [-v]\n", name);
+	fprintf(stderr, "  -t  simulated seconds to run (default 600)\n");
+	fprintf(stderr, "  -s  seed for obstacle placement and sensor noise (default 1)\n");
+	fprintf(stderr, "  -o  number of obstacles, at most %d (default 4)\n", SIM_MAX_OBSTACLES);
+	fprintf(stderr, "  -n  standard deviation of the analog sensor noise (default 20)\n");
+	fprintf(stderr, "  -T  let RE_GUI write its telemetry to this file, re_telemetry turns it into CSV\n");
+	fprintf(stderr, "  -v  show the robot program's own output\n");
+}
+/******************************************************/
+int main(int argc, char *argv[])
+{
+	sim_config config;
+	sim_default_config(&config);
+
+	int option;
+	while ((option = getopt(argc, argv, "t:s:o:n:T:vh")) != -1){
+		switch (option){
+			case 't': config.duration = atof(optarg); break;
+			case 's': config.seed = (unsigned int)strtoul(optarg, NULL, 0); break;
+			case 'o': config.obstacle_count = atoi(optarg); break;
+			case 'n': config.sensor_noise = atof(optarg); break;
+			case 'T': config.telemetry_path = optarg; break;
+			case 'v': config.show_output = true; break;
+			default:
+				print_usage(argv[0]);
+				return option == 'h' ? 0 : 2;
+		}
+	}
+
+	sim_metrics metrics;
+	sim_run(&config, robot_main, &metrics);
+
+	printf("simulated     %.1f s in %.3f s of wall time (%.0fx real time)\n", metrics.sim_seconds, metrics.wall_seconds,
+		metrics.wall_seconds > 0 ? metrics.sim_seconds / metrics.wall_seconds : 0);
+	printf("distance      %.2f m\n", metrics.distance);
+	printf("near light    %.1f s (%.1f%%)\n", metrics.time_near_light,
+		metrics.sim_seconds > 0 ? 100 * metrics.time_near_light / metrics.sim_seconds : 0);
+	printf("collisions    %d\n", metrics.collisions);
+	printf("servo writes  %lu\n", metrics.servo_writes);
+	return 0;
+}
@@ -0,0 +1,410 @@
+/*
+Vassar Cognitive Science - Robot Ethology
+
+Simulated KIPR Wombat library, see include/kipr/wombat.h.
+
+The clock only moves when the robot program sleeps: msleep() steps the world forward in 1 ms slices at whatever wheel speeds the
+servos were last set to.  A program that polls the clock without ever sleeping still makes progress, one virtual millisecond per
+SPIN_POLLS calls, so a busy wait cannot hang the simulator.  When the run's duration is used up the program is abandoned in the
+middle of whatever it was doing and sim_run() returns.
+*/
+
+#include <kipr/wombat.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include "sim.h"
+
+#undef clock_gettime // sim_run() times itself with the real clock
+
+#define SERVO_PORTS 4
+#define STEP_MICROS 1000	// the world is stepped 1 ms at a time
+#define SPIN_POLLS 10000	// clock reads without a sleep in between that count as a busy wait and cost 1 ms
+#define SERVO_SATURATION 0.25 // continuous rotation servos reach full speed this far (as a fraction of half the range) from center
+
+void (*sim_tick_hook)() = NULL;
+void sim_program_reset(const sim_config *config) __attribute__((weak)); // NULL unless the program's glue is linked in
+
+static sim_config config;
+static unsigned long long now_micros, end_micros;
+static unsigned long polls_since_sleep;
+static int servo_positions[SERVO_PORTS];
+static bool servo_enabled[SERVO_PORTS];
+static unsigned long servo_writes;
+static bool side_button_pending;
+static jmp_buf run_over;
+
+//========================================//
+//================HELPERS=================//
+//========================================//
+
+static double wheel_speed(int port, bool reversed)
+{
+	if (port < 0 || port >= SERVO_PORTS || !servo_enabled[port]) return 0;
+	double speed = (servo_positions[port] / 2047.0 * 2 - 1) / SERVO_SATURATION; // 1024 is stopped, speed grows either way from there
+	if (speed > 1) speed = 1;
+	if (speed < -1) speed = -1;
+	return reversed ? -speed : speed;
+}
+/******************************************************/
+static void advance(unsigned long long micros)
+{
+	unsigned long long target = now_micros + micros;
+	while (now_micros < target){
+		world_step(STEP_MICROS / 1e6, wheel_speed(config.wiring.left_motor_pin, config.wiring.left_motor_reversed),
+			wheel_speed(config.wiring.right_motor_pin, config.wiring.right_motor_reversed));
+		now_micros += STEP_MICROS;
+		if (now_micros >= end_micros) longjmp(run_over, 1);
+	}
+}
+/******************************************************/
+static void poll_clock()
+{
+	if (++polls_since_sleep >= SPIN_POLLS){
+		polls_since_sleep = 0;
+		advance(STEP_MICROS);
+	}
+}
+/******************************************************/
+static int clamp_reading(double value)
+{
+	value += config.sensor_noise * world_gaussian();
+	if (value < 0) return 0;
+	if (value > 4095) return 4095;
+	return (int)value;
+}
+
+//========================================//
+//================SENSORS=================//
+//========================================//
+
+int analog(int port)
+{
+	const sim_wiring *w = &config.wiring;
+	if (port == w->right_ir_pin) return clamp_reading(world_ir(false));
+	if (port == w->left_ir_pin) return clamp_reading(world_ir(true));
+	if (port == w->right_photo_pin) return clamp_reading(world_photo(false));
+	if (port == w->left_photo_pin) return clamp_reading(world_photo(true));
+	return 0; // nothing plugged in
+}
+/******************************************************/
+int analog10(int port)
+{
+	return analog(port) >> 2;
+}
+/******************************************************/
+int analog_et(int port)
+{
+	return analog(port);
+}
+/******************************************************/
+int digital(int port)
+{
+	const sim_wiring *w = &config.wiring;
+	unsigned char bumps = world_bumps();
+	unsigned char bit = 0;
+	if (port == w->front_bump_left_pin) bit = SIM_BUMP_FRONT_LEFT;
+	else if (port == w->front_bump_center_pin) bit = SIM_BUMP_FRONT_CENTER;
+	else if (port == w->front_bump_right_pin) bit = SIM_BUMP_FRONT_RIGHT;
+	else if (port == w->back_bump_left_pin) bit = SIM_BUMP_BACK_LEFT;
+	else if (port == w->back_bump_center_pin) bit = SIM_BUMP_BACK_CENTER;
+	else if (port == w->back_bump_right_pin) bit = SIM_BUMP_BACK_RIGHT;
+	return (bumps & bit) ? 0 : 1; // the bumpers are wired to read 0 while pressed
+}
+
+//========================================//
+//=================SERVOS=================//
+//========================================//
+
+void enable_servo(int port)
+{
+	if (port >= 0 && port < SERVO_PORTS) servo_enabled[port] = true;
+}
+/******************************************************/
+void disable_servo(int port)
+{
+	if (port >= 0 && port < SERVO_PORTS) servo_enabled[port] = false;
+}
+/******************************************************/
+void enable_servos()
+{
+	int port;
+	for (port = 0; port < SERVO_PORTS; port++) servo_enabled[port] = true;
+}
+/******************************************************/
+void disable_servos()
+{
+	int port;
+	for (port = 0; port < SERVO_PORTS; port++) servo_enabled[port] = false;
+}
+/******************************************************/
+void set_servo_position(int port, int position)
+{
+	servo_writes++;
+	if (port < 0 || port >= SERVO_PORTS) return;
+	if (position < 0) position = 0;
+	if (position > 2047) position = 2047;
+	servo_positions[port] = position;
+}
+/******************************************************/
+int get_servo_position(int port)
+{
+	return (port >= 0 && port < SERVO_PORTS) ? servo_positions[port] : 0;
+}
+
+//========================================//
+//==================TIME==================//
+//========================================//
+
+unsigned long systime()
+{
+	poll_clock();
+	return (unsigned long)(now_micros / 1000);
+}
+/******************************************************/
+void msleep(long msecs)
+{
+	if (sim_tick_hook) sim_tick_hook();
+	polls_since_sleep = 0;
+	if (msecs > 0) advance((unsigned long long)msecs * 1000);
+}
+/******************************************************/
+double seconds()
+{
+	poll_clock();
+	return now_micros / 1e6;
+}
+/******************************************************/
+int sim_clock_gettime(clockid_t clock, struct timespec *now)
+{
+	(void)clock; // every clock is the virtual clock
+	poll_clock();
+	now->tv_sec = now_micros / 1000000;
+	now->tv_nsec = (now_micros % 1000000) * 1000;
+	return 0;
+}
+
+//========================================//
+//===========BUTTONS AND SCREEN===========//
+//========================================//
+
+int side_button_clicked()
+{
+	bool clicked = side_button_pending;
+	side_button_pending = false;
+	return clicked;
+}
+int side_button() { return 0; }
+int a_button() { return 0; }
+int c_button() { return 0; }
+int a_button_clicked() { return 0; }
+int b_button_clicked() { return 0; }
+int c_button_clicked() { return 0; }
+int x_button_clicked() { return 0; }
+int y_button_clicked() { return 0; }
+int z_button_clicked() { return 0; }
+void set_a_button_text(const char *text) { (void)text; }
+void set_b_button_text(const char *text) { (void)text; }
+void set_c_button_text(const char *text) { (void)text; }
+void set_x_button_text(const char *text) { (void)text; }
+void set_y_button_text(const char *text) { (void)text; }
+void set_z_button_text(const char *text) { (void)text; }
+void set_extra_buttons_visible(int visible) { (void)visible; }
+/******************************************************/
+void display_printf(int column, int row, const char *format, ...)
+{
+	(void)column;
+	(void)row;
+	va_list args;
+	va_start(args, format);
+	vprintf(format, args); // stdout is already pointed at /dev/null unless the run shows output
+	va_end(args);
+}
+/******************************************************/
+void console_clear()
+{
+}
+
+//========================================//
+//============CAMERA AND GRAPHICS=========//
+//========================================//
+
+// a synthetic BGR camera: a bright square drifting across a dim, slightly noisy background, so consecutive frames differ a little
+static int camera_width = 160, camera_height = 120;
+static unsigned char *camera_frame = NULL;
+static unsigned long camera_frames = 0;
+
+void sim_camera_size(int width, int height)
+{
+	camera_width = width;
+	camera_height = height;
+	free(camera_frame);
+	camera_frame = NULL;
+	camera_update();
+}
+/******************************************************/
+int camera_open()
+{
+	return camera_update();
+}
+/******************************************************/
+int camera_update()
+{
+	if (!camera_frame){
+		camera_frame = malloc((size_t)camera_width * camera_height * 3);
+		if (!camera_frame) return 0;
+	}
+	int side = camera_height / 4;
+	int left = (int)(camera_frames * 3 % (camera_width - side)), top = camera_height / 2 - side / 2;
+	int x, y;
+	for (y = 0; y < camera_height; y++){
+		unsigned char *row = camera_frame + (size_t)y * camera_width * 3;
+		for (x = 0; x < camera_width; x++){
+			bool lit = x >= left && x < left + side && y >= top && y < top + side;
+			unsigned char noise = (unsigned char)((x * 7 + y * 13 + camera_frames * 5) & 7);
+			row[3 * x + 0] = (lit ? 200 : 40) + noise;
+			row[3 * x + 1] = (lit ? 220 : 50) + noise;
+			row[3 * x + 2] = (lit ? 240 : 60) + noise;
+		}
+	}
+	camera_frames++;
+	return 1;
+}
+/******************************************************/
+const unsigned char *get_camera_frame()
+{
+	return camera_frame;
+}
+int get_camera_width() { return camera_width; }
+int get_camera_height() { return camera_height; }
+void camera_close()
+{
+	free(camera_frame);
+	camera_frame = NULL;
+}
+/******************************************************/
+int graphics_open(int width, int height)
+{
+	(void)width;
+	(void)height;
+	return 1;
+}
+void graphics_close() {}
+void graphics_update() {}
+void graphics_pixel(int x, int y, int red, int green, int blue) { (void)x; (void)y; (void)red; (void)green; (void)blue; }
+void graphics_blit_enc(const unsigned char *data, enum Encoding encoding, int x, int y, int width, int height)
+{
+	(void)data; (void)encoding; (void)x; (void)y; (void)width; (void)height;
+}
+int get_key_state(int key)
+{
+	(void)key;
+	return 0; // no keyboard
+}
+
+//========================================//
+//================THREADS=================//
+//========================================//
+
+thread thread_create(thread_function function)
+{
+	(void)function;
+	fprintf(stderr, "re_sim: threads are not simulated, the thread will never run\n");
+	return NULL;
+}
+void thread_start(thread id) { (void)id; }
+void thread_wait(thread id) { (void)id; }
+void thread_destroy(thread id) { (void)id; }
+
+//========================================//
+//==================RUN===================//
+//========================================//
+
+void sim_default_config(sim_config *c)
+{
+	c->duration = 600;
+	c->arena_width = 2.0;
+	c->arena_height = 2.0;
+	c->obstacle_count = 4;
+	c->light_x = 1.6;
+	c->light_y = 1.6;
+	c->near_light_radius = 0.4;
+	c->start_x = 0.4;
+	c->start_y = 0.4;
+	c->start_heading = 0;
+	c->sensor_noise = 20;
+	c->seed = 1;
+	c->press_side_button = true;
+	c->show_output = false;
+	c->telemetry_path = NULL;
+
+	c->wiring.right_ir_pin = 2;
+	c->wiring.left_ir_pin = 3;
+	c->wiring.right_photo_pin = 0;
+	c->wiring.left_photo_pin = 1;
+	c->wiring.front_bump_left_pin = 5;
+	c->wiring.front_bump_center_pin = 3;
+	c->wiring.front_bump_right_pin = 4;
+	c->wiring.back_bump_left_pin = 2;
+	c->wiring.back_bump_center_pin = 0;
+	c->wiring.back_bump_right_pin = 1;
+	c->wiring.right_motor_pin = 0;
+	c->wiring.left_motor_pin = 1;
+	c->wiring.right_motor_reversed = true; // the right servo is mounted mirrored, drive() maps its speed from 2047 down to 0
+	c->wiring.left_motor_reversed = false;
+}
+/******************************************************/
+void sim_reset(const sim_config *c)
+{
+	config = *c;
+	now_micros = 0;
+	end_micros = (unsigned long long)(c->duration * 1e6);
+	polls_since_sleep = 0;
+	servo_writes = 0;
+	side_button_pending = c->press_side_button;
+	int port;
+	for (port = 0; port < SERVO_PORTS; port++){
+		servo_positions[port] = 1024;
+		servo_enabled[port] = false;
+	}
+	world_reset(c);
+	if (sim_program_reset) sim_program_reset(c);
+}
+/******************************************************/
+int sim_run(const sim_config *c, int (*robot_main)(), sim_metrics *metrics)
+{
+	sim_reset(c);
+
+	// hide the program's own printing unless asked for it
+	fflush(stdout);
+	int saved_stdout = -1;
+	if (!c->show_output){
+		saved_stdout = dup(STDOUT_FILENO);
+		int null_fd = open("/dev/null", O_WRONLY);
+		if (null_fd >= 0){
+			dup2(null_fd, STDOUT_FILENO);
+			close(null_fd);
+		}
+	}
+
+	struct timespec wall_start, wall_end;
+	clock_gettime(CLOCK_MONOTONIC, &wall_start);
+	int status = 0;
+	if (setjmp(run_over) == 0){
+		status = robot_main(); // only returns if the program ends on its own before the time is up
+	}
+	clock_gettime(CLOCK_MONOTONIC, &wall_end);
+
+	fflush(stdout);
+	if (saved_stdout >= 0){
+		dup2(saved_stdout, STDOUT_FILENO);
+		close(saved_stdout);
+	}
+
+	world_metrics(metrics);
+	metrics->wall_seconds = (wall_end.tv_sec - wall_start.tv_sec) + (wall_end.tv_nsec - wall_start.tv_nsec) / 1e9;
+	metrics->servo_writes = servo_writes;
+	return status;
+}
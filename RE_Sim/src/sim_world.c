@@ -0,0 +1,236 @@
+/*
+Vassar Cognitive Science - Robot Ethology
+
+World model for the headless simulator: a round, two wheeled robot in a walled, rectangular arena with round obstacles and one light.
+
+Sensors are modelled loosely on the real ones, close enough that the thresholds used on the robot give similar behavior:
+	IR		ray cast from the robot's edge, 30 degrees either side of its heading; closer obstacles read higher
+	photo	facing 40 degrees either side of the heading; falls off with distance and angle to the light; greater means darker
+	bumpers	pressed while something touches the robot within the bumper's arc of its body
+*/
+
+#include <math.h>
+#include "sim.h"
+
+#define ROBOT_RADIUS 0.09		// meters
+#define WHEEL_BASE 0.15			// meters between the wheels
+#define MAX_WHEEL_SPEED 0.2		// meters per second at full servo speed
+#define CONTACT_MARGIN 0.002	// meters, how close something has to be to press a bumper
+#define IR_ANGLE (M_PI / 6)		// IR sensors point 30 degrees off the heading
+#define IR_RANGE 1.5			// meters, farther than this reads as open space
+#define IR_FALLOFF 0.08			// meters at which an IR reading is half its maximum
+#define PHOTO_ANGLE (2 * M_PI / 9) // photo sensors point 40 degrees off the heading
+#define PHOTO_FALLOFF 1.0		// meters at which the light seen head on is half as bright
+#define PHOTO_DARK 4095.0		// reading with no light at all
+#define PHOTO_SPAN 3500.0		// how much a light right in front of a sensor lowers its reading
+
+// *** Define an obstacle *** //
+typedef struct obstacle{
+	double x, y, radius;
+} obstacle;
+
+// world state, static so none of it clashes with the robot program's own globals when they are linked together
+static sim_config world;
+static obstacle obstacles[SIM_MAX_OBSTACLES];
+static int obstacle_count;
+static double robot_x, robot_y, robot_heading;
+
+// what has been measured so far
+static double travelled, near_light_time, elapsed;
+static int collisions;
+static unsigned char last_bumps;
+
+// noise and obstacle placement
+static unsigned long long rng_state;
+static bool has_spare_gaussian;
+static double spare_gaussian;
+
+/******************************************************/
+static double uniform()
+{
+	rng_state = rng_state * 6364136223846793005ULL + 1442695040888963407ULL; // 64 bit LCG (Knuth's MMIX constants)
+	return (rng_state >> 11) * (1.0 / 9007199254740992.0);					 // top 53 bits, in [0, 1)
+}
+/******************************************************/
+double world_gaussian()
+{
+	if (has_spare_gaussian){
+		has_spare_gaussian = false;
+		return spare_gaussian;
+	}
+	double u = uniform(), v = uniform();
+	double r = sqrt(-2.0 * log(1.0 - u)); // Box-Muller, 1-u is never 0
+	spare_gaussian = r * sin(2 * M_PI * v);
+	has_spare_gaussian = true;
+	return r * cos(2 * M_PI * v);
+}
+/******************************************************/
+static double wrap_angle(double angle)
+{
+	while (angle > M_PI) angle -= 2 * M_PI;
+	while (angle <= -M_PI) angle += 2 * M_PI;
+	return angle;
+}
+/******************************************************/
+static bool robot_fits(double x, double y)
+{
+	if (x < ROBOT_RADIUS || y < ROBOT_RADIUS || x > world.arena_width - ROBOT_RADIUS || y > world.arena_height - ROBOT_RADIUS) return false;
+	int i;
+	for (i = 0; i < obstacle_count; i++){
+		double reach = obstacles[i].radius + ROBOT_RADIUS;
+		double dx = x - obstacles[i].x, dy = y - obstacles[i].y;
+		if (dx * dx + dy * dy < reach * reach) return false;
+	}
+	return true;
+}
+/******************************************************/
+void world_reset(const sim_config *config)
+{
+	world = *config;
+	rng_state = config->seed;
+	has_spare_gaussian = false;
+	uniform(); // mix the seed in once so seeds 0, 1, 2... don't start out correlated
+
+	robot_x = config->start_x;
+	robot_y = config->start_y;
+	robot_heading = config->start_heading;
+
+	// place the obstacles at random, keeping them clear of the walls, the light, the robot's start and each other
+	obstacle_count = 0;
+	int wanted = config->obstacle_count < SIM_MAX_OBSTACLES ? config->obstacle_count : SIM_MAX_OBSTACLES;
+	int attempts;
+	for (attempts = 0; obstacle_count < wanted && attempts < 1000; attempts++){
+		obstacle o;
+		o.radius = 0.05 + 0.1 * uniform();
+		o.x = o.radius + (config->arena_width - 2 * o.radius) * uniform();
+		o.y = o.radius + (config->arena_height - 2 * o.radius) * uniform();
+
+		bool clear = hypot(o.x - robot_x, o.y - robot_y) > o.radius + ROBOT_RADIUS + 0.2
+			&& hypot(o.x - config->light_x, o.y - config->light_y) > o.radius + 0.2;
+		int i;
+		for (i = 0; clear && i < obstacle_count; i++){
+			clear = hypot(o.x - obstacles[i].x, o.y - obstacles[i].y) > o.radius + obstacles[i].radius + 2 * ROBOT_RADIUS + 0.05; // leave room to drive between
+		}
+		if (clear) obstacles[obstacle_count++] = o;
+	}
+
+	travelled = 0;
+	near_light_time = 0;
+	elapsed = 0;
+	collisions = 0;
+	last_bumps = world_bumps();
+}
+/******************************************************/
+void world_step(double dt, double left_speed, double right_speed)
+{
+	double left = left_speed * MAX_WHEEL_SPEED, right = right_speed * MAX_WHEEL_SPEED;
+	double forward = (left + right) / 2 * dt;
+	robot_heading = wrap_angle(robot_heading + (right - left) / WHEEL_BASE * dt); // turning in place is never blocked, the robot is round
+
+	double dx = forward * cos(robot_heading), dy = forward * sin(robot_heading);
+	double fraction = 1.0;
+	if (!robot_fits(robot_x + dx, robot_y + dy)){
+		// blocked: move up to the point of contact instead
+		double low = 0, high = 1;
+		int i;
+		for (i = 0; i < 20; i++){
+			double middle = (low + high) / 2;
+			if (robot_fits(robot_x + middle * dx, robot_y + middle * dy)) low = middle;
+			else high = middle;
+		}
+		fraction = low;
+	}
+	robot_x += fraction * dx;
+	robot_y += fraction * dy;
+	travelled += fabs(fraction * forward);
+
+	elapsed += dt;
+	if (hypot(robot_x - world.light_x, robot_y - world.light_y) <= world.near_light_radius) near_light_time += dt;
+
+	unsigned char bumps = world_bumps();
+	unsigned char pressed = bumps & ~last_bumps;
+	while (pressed){
+		collisions++; // count every bumper that was newly pressed
+		pressed &= pressed - 1;
+	}
+	last_bumps = bumps;
+}
+/******************************************************/
+static unsigned char bumper_at(double direction)
+{
+	double angle = wrap_angle(direction - robot_heading) * 180 / M_PI; // where the contact is around the robot, positive is to its left
+	if (fabs(angle) <= 15) return SIM_BUMP_FRONT_CENTER;
+	if (fabs(angle) >= 165) return SIM_BUMP_BACK_CENTER;
+	if (angle > 0) return angle < 90 ? SIM_BUMP_FRONT_LEFT : SIM_BUMP_BACK_LEFT;
+	return angle > -90 ? SIM_BUMP_FRONT_RIGHT : SIM_BUMP_BACK_RIGHT;
+}
+/******************************************************/
+unsigned char world_bumps()
+{
+	unsigned char bumps = 0;
+	double touch = ROBOT_RADIUS + CONTACT_MARGIN;
+
+	if (robot_x <= touch) bumps |= bumper_at(M_PI);
+	if (robot_x >= world.arena_width - touch) bumps |= bumper_at(0);
+	if (robot_y <= touch) bumps |= bumper_at(-M_PI / 2);
+	if (robot_y >= world.arena_height - touch) bumps |= bumper_at(M_PI / 2);
+
+	int i;
+	for (i = 0; i < obstacle_count; i++){
+		double dx = obstacles[i].x - robot_x, dy = obstacles[i].y - robot_y;
+		if (hypot(dx, dy) <= obstacles[i].radius + touch) bumps |= bumper_at(atan2(dy, dx));
+	}
+	return bumps;
+}
+/******************************************************/
+static double ray_distance(double angle)
+{
+	// distance from the robot's center to the nearest wall or obstacle along angle
+	double ux = cos(angle), uy = sin(angle);
+	double nearest = IR_RANGE + ROBOT_RADIUS;
+
+	if (ux > 0) nearest = fmin(nearest, (world.arena_width - robot_x) / ux);
+	if (ux < 0) nearest = fmin(nearest, -robot_x / ux);
+	if (uy > 0) nearest = fmin(nearest, (world.arena_height - robot_y) / uy);
+	if (uy < 0) nearest = fmin(nearest, -robot_y / uy);
+
+	int i;
+	for (i = 0; i < obstacle_count; i++){
+		double ox = obstacles[i].x - robot_x, oy = obstacles[i].y - robot_y;
+		double along = ox * ux + oy * uy;
+		if (along <= 0) continue;
+		double across = ox * ox + oy * oy - along * along;
+		double r2 = obstacles[i].radius * obstacles[i].radius;
+		if (across > r2) continue;
+		nearest = fmin(nearest, along - sqrt(r2 - across));
+	}
+	return nearest;
+}
+/******************************************************/
+double world_ir(bool left)
+{
+	double distance = ray_distance(robot_heading + (left ? IR_ANGLE : -IR_ANGLE)) - ROBOT_RADIUS;
+	if (distance >= IR_RANGE) return 0;
+	if (distance < 0) distance = 0;
+	double scaled = distance / IR_FALLOFF;
+	return 4095.0 / (1 + scaled * scaled);
+}
+/******************************************************/
+double world_photo(bool left)
+{
+	double facing = robot_heading + (left ? PHOTO_ANGLE : -PHOTO_ANGLE);
+	double dx = world.light_x - robot_x, dy = world.light_y - robot_y;
+	double distance = hypot(dx, dy);
+	double alignment = distance > 0 ? (dx * cos(facing) + dy * sin(facing)) / distance : 1;
+	if (alignment < 0) alignment = 0; // the light is behind this sensor
+	double scaled = distance / PHOTO_FALLOFF;
+	return PHOTO_DARK - PHOTO_SPAN * alignment / (1 + scaled * scaled);
+}
+/******************************************************/
+void world_metrics(sim_metrics *metrics)
+{
+	metrics->sim_seconds = elapsed;
+	metrics->distance = travelled;
+	metrics->time_near_light = near_light_time;
+	metrics->collisions = collisions;
+}
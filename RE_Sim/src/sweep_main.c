@@ -0,0 +1,264 @@
+/*
+Vassar Cognitive Science - Robot Ethology
+
+Parameter sweep: runs RE_GUI in the simulator for every combination of the given threshold and action tuning values, on every
+core, and writes the averaged metrics of each combination to a results file.
+
+	re_sweep -p avoid_threshold=1200:2000:200 -p cruise_speed=0.05:0.2:0.05 -H "AVOID,SEEK LIGHT,CRUISE STRAIGHT" -r 3 -f sweep.bin
+
+Every combination is run once per seed 1..runs, so all combinations face the same arenas and the same sensor noise.
+
+Results file (host byte order):
+	header		sweep_file_header
+	names		parameter_count names, SWEEP_NAME_LENGTH bytes each, zero padded
+	records		configuration_count records of parameter_count floats (the values) followed by a sweep_metrics
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "sim.h"
+#include "batch.h"
+#include "robot.h"
+
+#define MAX_PARAMETERS 16
+#define SWEEP_NAME_LENGTH 32
+#define SWEEP_VERSION 1
+
+int robot_main(); // RE_GUI's main(), renamed when it was compiled for the simulator
+
+// *** Define the results file header *** //
+typedef struct sweep_file_header{
+	char magic[8];					// "RESWEEP" and a zero
+	uint32_t version;				// SWEEP_VERSION
+	uint32_t parameter_count;
+	uint32_t configuration_count;
+	uint32_t runs;					// seeds each configuration was run with
+	double duration;				// simulated seconds per run
+} sweep_file_header;
+
+// *** Define the metrics of one configuration, averaged over its runs *** //
+typedef struct sweep_metrics{
+	float collisions;
+	float time_near_light;	// seconds
+	float distance;			// meters
+	uint32_t failed_runs;	// runs that crashed and are left out of the averages
+} sweep_metrics;
+
+// *** Define one swept parameter and the values it takes *** //
+typedef struct sweep_parameter{
+	const robot_tunable *tunable;
+	double first, step;
+	int count;
+} sweep_parameter;
+
+// *** Define what one run reports back *** //
+typedef struct run_result{
+	float collisions, time_near_light, distance;
+	int completed; // stays 0 if the run's process crashed
+} run_result;
+
+// *** Define everything a run needs to know *** //
+typedef struct sweep{
+	sweep_parameter parameters[MAX_PARAMETERS];
+	int parameter_count;
+	int configuration_count;
+	int runs;
+	sim_config config;
+} sweep;
+
+/******************************************************/
+double parameter_value(const sweep *s, int configuration, int parameter)
+{
+	// configurations count through the parameter values like an odometer, the last parameter changing fastest
+	int i;
+	for (i = s->parameter_count - 1; i > parameter; i--) configuration /= s->parameters[i].count;
+	const sweep_parameter *p = &s->parameters[parameter];
+	return p->first + (configuration % p->count) * p->step;
+}
+/******************************************************/
+void run_configuration(int index, void *result, void *context)
+{
+	const sweep *s = context;
+	int configuration = index / s->runs;
+	int i;
+	for (i = 0; i < s->parameter_count; i++) set_tunable(s->parameters[i].tunable, parameter_value(s, configuration, i));
+
+	sim_config config = s->config;
+	config.seed = index % s->runs + 1;
+	sim_metrics metrics;
+	sim_run(&config, robot_main, &metrics);
+
+	run_result *r = result;
+	r->collisions = metrics.collisions;
+	r->time_near_light = metrics.time_near_light;
+	r->distance = metrics.distance;
+	r->completed = 1;
+}
+/******************************************************/
+bool parse_parameter(const char *text, sweep_parameter *p)
+{
+	// name=value or name=first:last:step
+	char name[SWEEP_NAME_LENGTH];
+	const char *equals = strchr(text, '=');
+	if (!equals || equals - text >= SWEEP_NAME_LENGTH){
+		fprintf(stderr, "expected name=value or name=first:last:step, got \"%s\"\n", text);
+		return false;
+	}
+	memcpy(name, text, equals - text);
+	name[equals - text] = '\0';
+	p->tunable = find_tunable(name);
+	if (!p->tunable){
+		fprintf(stderr, "unknown parameter \"%s\", -l lists them\n", name);
+		return false;
+	}
+
+	double last;
+	int fields = sscanf(equals + 1, "%lf:%lf:%lf", &p->first, &last, &p->step);
+	if (fields == 1){
+		p->step = 0;
+		p->count = 1;
+	}
+	else if (fields == 3 && p->step > 0 && last >= p->first){
+		p->count = (int)((last - p->first) / p->step + 1e-9) + 1;
+	}
+	else{
+		fprintf(stderr, "bad range for %s, expected first:last:step with a positive step\n", name);
+		return false;
+	}
+	return true;
+}
+/******************************************************/
+void print_usage(const char *name)
+{
+	fprintf(stderr, "usage: %s -p name=first:last:step [-p ...] [-H hierarchy] [-t seconds] [-r runs] [-o obstacles] [-j jobs] [-f results] [-c csv]\n", name);
+	fprintf(stderr, "  -p  parameter to sweep, or name=value to hold it at another value; -l lists them\n");
+	fprintf(stderr, "  -H  active behaviors, highest ranked first, e.g. \"ESCAPE FRONT,AVOID,SEEK LIGHT,CRUISE STRAIGHT\"\n");
+	fprintf(stderr, "  -t  simulated seconds per run (default 300)\n");
+	fprintf(stderr, "  -r  runs per configuration, with seeds 1 to runs (default 3)\n");
+	fprintf(stderr, "  -o  obstacles in the arena (default 4)\n");
+	fprintf(stderr, "  -j  processes to run at once (default one per core)\n");
+	fprintf(stderr, "  -f  results file (default sweep.bin)\n");
+	fprintf(stderr, "  -c  also write the results as CSV to this file\n");
+}
+/******************************************************/
+int main(int argc, char *argv[])
+{
+	static sweep s; // shared read only with every run process
+	sim_default_config(&s.config);
+	s.config.duration = 300;
+	s.runs = 3;
+	int jobs = 0;
+	const char *results_path = "sweep.bin";
+	const char *csv_path = NULL;
+
+	int option, i;
+	while ((option = getopt(argc, argv, "p:H:t:r:o:j:f:c:lh")) != -1){
+		switch (option){
+			case 'p':
+				if (s.parameter_count == MAX_PARAMETERS){
+					fprintf(stderr, "at most %d parameters\n", MAX_PARAMETERS);
+					return 2;
+				}
+				if (!parse_parameter(optarg, &s.parameters[s.parameter_count++])) return 2;
+				break;
+			case 'H':
+				if (!set_hierarchy(optarg)) return 2; // set once here, every run process inherits it
+				break;
+			case 't': s.config.duration = atof(optarg); break;
+			case 'r': s.runs = atoi(optarg); break;
+			case 'o': s.config.obstacle_count = atoi(optarg); break;
+			case 'j': jobs = atoi(optarg); break;
+			case 'f': results_path = optarg; break;
+			case 'c': csv_path = optarg; break;
+			case 'l':
+				for (i = 0; i < robot_tunable_count; i++) printf("%-20s %g\n", robot_tunables[i].name, get_tunable(&robot_tunables[i]));
+				return 0;
+			default:
+				print_usage(argv[0]);
+				return option == 'h' ? 0 : 2;
+		}
+	}
+	if (s.runs < 1) s.runs = 1;
+
+	s.configuration_count = 1;
+	for (i = 0; i < s.parameter_count; i++) s.configuration_count *= s.parameters[i].count;
+	int task_count = s.configuration_count * s.runs;
+	fprintf(stderr, "%d configurations x %d runs of %.0f simulated seconds on %d processes\n", s.configuration_count, s.runs,
+		s.config.duration, jobs > 0 ? jobs : batch_cores());
+
+	run_result *runs = calloc(task_count, sizeof(run_result));
+	if (!runs){
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+	int failed = batch_run(task_count, jobs, run_configuration, &s, runs, sizeof(run_result), isatty(STDERR_FILENO));
+	if (failed) fprintf(stderr, "%d runs failed\n", failed);
+
+	FILE *results = fopen(results_path, "wb");
+	FILE *csv = csv_path ? fopen(csv_path, "w") : NULL;
+	if (!results || (csv_path && !csv)){
+		perror(!results ? results_path : csv_path);
+		return 1;
+	}
+
+	sweep_file_header header = {"RESWEEP", SWEEP_VERSION, s.parameter_count, s.configuration_count, s.runs, s.config.duration};
+	fwrite(&header, sizeof(header), 1, results);
+	for (i = 0; i < s.parameter_count; i++){
+		char name[SWEEP_NAME_LENGTH] = {0};
+		strncpy(name, s.parameters[i].tunable->name, SWEEP_NAME_LENGTH - 1);
+		fwrite(name, SWEEP_NAME_LENGTH, 1, results);
+		if (csv) fprintf(csv, "%s,", name);
+	}
+	if (csv) fprintf(csv, "collisions,time_near_light,distance,failed_runs\n");
+
+	int best = -1;
+	float best_near_light = -1;
+	int configuration;
+	for (configuration = 0; configuration < s.configuration_count; configuration++){
+		sweep_metrics metrics = {0, 0, 0, 0};
+		int run, completed = 0;
+		for (run = 0; run < s.runs; run++){
+			const run_result *r = &runs[configuration * s.runs + run];
+			if (!r->completed){
+				metrics.failed_runs++;
+				continue;
+			}
+			metrics.collisions += r->collisions;
+			metrics.time_near_light += r->time_near_light;
+			metrics.distance += r->distance;
+			completed++;
+		}
+		if (completed){
+			metrics.collisions /= completed;
+			metrics.time_near_light /= completed;
+			metrics.distance /= completed;
+		}
+
+		float values[MAX_PARAMETERS];
+		for (i = 0; i < s.parameter_count; i++){
+			values[i] = (float)parameter_value(&s, configuration, i);
+			if (csv) fprintf(csv, "%g,", values[i]);
+		}
+		fwrite(values, sizeof(float), s.parameter_count, results);
+		fwrite(&metrics, sizeof(metrics), 1, results);
+		if (csv) fprintf(csv, "%g,%g,%g,%u\n", metrics.collisions, metrics.time_near_light, metrics.distance, metrics.failed_runs);
+
+		if (completed && metrics.time_near_light > best_near_light){
+			best_near_light = metrics.time_near_light;
+			best = configuration;
+		}
+	}
+	fclose(results);
+	if (csv) fclose(csv);
+
+	if (best >= 0){
+		printf("most time near the light: %.1f s with", best_near_light);
+		for (i = 0; i < s.parameter_count; i++) printf(" %s=%g", s.parameters[i].tunable->name, parameter_value(&s, best, i));
+		printf("\n");
+	}
+	free(runs);
+	return failed ? 1 : 0;
+}
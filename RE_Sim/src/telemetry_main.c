@@ -0,0 +1,78 @@
+/*
+Vassar Cognitive Science - Robot Ethology
+
+Telemetry decoder: turns a telemetry file written by RE_GUI (see RE_GUI/include/telemetry.h) into CSV, oldest tick first.
+
+	re_telemetry re_telemetry.bin > telemetry.csv
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "telemetry.h"
+
+// behavior titles by type key, as in RE_GUI's subsumption_hierarchy
+static const char *behavior_titles[] = {"SEEK LIGHT", "SEEK DARK", "APPROACH", "AVOID", "ESCAPE FRONT", "ESCAPE BACK", "CRUISE STRAIGHT", "CRUISE ARC", "MOTION"};
+
+/******************************************************/
+const char *winner_title(int winner)
+{
+	if (winner == TELEMETRY_NO_ARBITRATION) return "";
+	if (winner == TELEMETRY_STOPPED) return "STOP";
+	if (winner >= 0 && winner < (int)(sizeof(behavior_titles) / sizeof(behavior_titles[0]))) return behavior_titles[winner];
+	return "?";
+}
+/******************************************************/
+int main(int argc, char *argv[])
+{
+	if (argc != 2){
+		fprintf(stderr, "usage: %s telemetry_file > telemetry.csv\n", argv[0]);
+		return 2;
+	}
+
+	int file = open(argv[1], O_RDONLY);
+	struct stat info;
+	if (file < 0 || fstat(file, &info) != 0){
+		perror(argv[1]);
+		return 1;
+	}
+	if ((size_t)info.st_size < sizeof(telemetry_header)){
+		fprintf(stderr, "%s is too short to be a telemetry file\n", argv[1]);
+		return 1;
+	}
+	const unsigned char *memory = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (memory == MAP_FAILED){
+		perror(argv[1]);
+		return 1;
+	}
+
+	const telemetry_header *header = (const telemetry_header *)memory;
+	if (memcmp(header->magic, TELEMETRY_MAGIC, sizeof(header->magic)) != 0 || header->version != TELEMETRY_VERSION
+		|| header->record_size != sizeof(telemetry_record)){
+		fprintf(stderr, "%s is not a version %d telemetry file\n", argv[1], TELEMETRY_VERSION);
+		return 1;
+	}
+	if (sizeof(telemetry_header) + (size_t)header->capacity * sizeof(telemetry_record) > (size_t)info.st_size){
+		fprintf(stderr, "%s is truncated\n", argv[1]);
+		return 1;
+	}
+
+	const telemetry_record *records = (const telemetry_record *)(header + 1);
+	unsigned long long count = header->record_count;
+	unsigned long long first = count > header->capacity ? count - header->capacity : 0; // older records have been overwritten
+
+	printf("tick,timestamp_us,right_photo,left_photo,right_ir,left_ir,left_motion,right_motion,bumps,sensors_read,winner,winner_title,phase,left_position,right_position,timer_duration\n");
+	unsigned long long n;
+	for (n = first; n < count; n++){
+		const telemetry_record *r = &records[n % header->capacity];
+		printf("%u,%llu,%d,%d,%d,%d,%u,%u,0x%02x,0x%02x,%d,%s,%u,%d,%d,%d\n", r->tick, (unsigned long long)r->timestamp, r->right_photo, r->left_photo,
+			r->right_ir, r->left_ir, r->left_motion, r->right_motion, r->bumps, r->sensors_read, r->winner, winner_title(r->winner), r->phase, r->left_position, r->right_position,
+			r->timer_duration);
+	}
+	munmap((void *)memory, info.st_size);
+	return 0;
+}
@@ -0,0 +1,122 @@
+/*
+Vassar Cognitive Science - Robot Ethology
+
+Thread check for RE_GUI/src/main.c: runs the code shared between threads on real threads against the simulated wombat, built with
+ThreadSanitizer by `make tsan`.  Threads are not simulated, so re_sim and the batch tools never run these paths.
+
+	- an acquisition thread publishes snapshots with publish_snapshot() while the control thread copies them with latest_snapshot()
+	  and sensor_history_at(), checking that every copy is whole
+	- watch_motion() runs on its own thread while the control thread reads the motion scores with read_sensor_groups(), and turns
+	  the VISION group off and on again so the thread also passes through its resting state
+
+The simulated library itself is not thread safe, so each check has only one thread calling into it.
+*/
+
+#define main robot_main // the program's main() is never run here
+#include "../../RE_GUI/src/main.c"
+#undef main
+
+#include <pthread.h>
+#include "sim.h"
+
+#define SNAPSHOTS 200000 // snapshots the acquisition thread publishes, a few thousand laps of the history ring
+#define MOTION_READS 20000 // motion score reads by the control thread
+
+static atomic_int acquisition_done = 0;
+static int failures = 0;
+
+/******************************************************/
+static void check(bool condition, const char *what)
+{
+	if (condition) return;
+	fprintf(stderr, "re_threads: %s\n", what);
+	failures++;
+}
+/******************************************************/
+static void *acquire_snapshots(void *unused)
+{
+	(void)unused;
+	long n;
+	for (n = 0; n < SNAPSHOTS; n++) publish_snapshot(ALL_SENSORS);
+	atomic_store(&acquisition_done, 1);
+	return NULL;
+}
+/******************************************************/
+static void check_snapshots()
+{
+	// every snapshot is published whole with sensors_read set to ALL_SENSORS, and the virtual clock never goes backwards,
+	// so a copy that is torn or out of order shows up as a wrong sensors_read or a timestamp older than one already seen
+	publish_snapshot(ALL_SENSORS);
+	pthread_t writer;
+	if (pthread_create(&writer, NULL, acquire_snapshots, NULL) != 0){
+		check(false, "could not start the acquisition thread");
+		return;
+	}
+	unsigned long long newest = 0;
+	unsigned long copies = 0;
+	while (!atomic_load(&acquisition_done)){
+		sensor_snapshot snapshot, older;
+		bool have_older = sensor_history_at(SENSOR_HISTORY_LENGTH / 2, &older); // copied first, so it can't be newer than the latest copied next
+		if (!latest_snapshot(&snapshot)) continue;
+		check(snapshot.sensors_read == ALL_SENSORS, "torn snapshot");
+		check(snapshot.timestamp >= newest, "snapshot older than the one before");
+		newest = snapshot.timestamp;
+		if (have_older){
+			check(older.sensors_read == ALL_SENSORS, "torn snapshot from the history");
+			check(older.timestamp <= snapshot.timestamp, "history snapshot newer than the latest");
+		}
+		copies++;
+		if (failures > 10) break;
+	}
+	pthread_join(writer, NULL);
+	printf("snapshots: %lu published, %lu copied\n", (unsigned long)atomic_load(&sensor_count), copies);
+}
+/******************************************************/
+static void *run_vision(void *unused)
+{
+	(void)unused;
+	watch_motion(); // never returns, the process ends with it running
+	return NULL;
+}
+/******************************************************/
+static void check_motion()
+{
+	sim_camera_size(160, 120); // the synthetic camera's square drifts across the image, so there is always motion somewhere
+	camera_open();
+	atomic_store(&required_sensors, ALL_SENSORS);
+	pthread_t vision;
+	if (pthread_create(&vision, NULL, run_vision, NULL) != 0){
+		check(false, "could not start the vision thread");
+		return;
+	}
+	struct timespec pause = {0, 100000}; // real time, the virtual clock only moves for the thread calling into the simulator
+	unsigned long seen_motion = 0;
+	int n;
+	for (n = 0; n < MOTION_READS; n++){
+		if (n == MOTION_READS / 3) atomic_store(&required_sensors, ALL_SENSORS & ~VISION_SENSORS); // rest for a while
+		if (n == 2 * MOTION_READS / 3) atomic_store(&required_sensors, ALL_SENSORS);
+		sensor_snapshot snapshot = {0};
+		read_sensor_groups(&snapshot, VISION_SENSORS);
+		check(snapshot.left_motion <= 255 && snapshot.right_motion <= 255, "motion score out of range");
+		if (snapshot.left_motion || snapshot.right_motion) seen_motion++;
+		if (n % 16 == 0) nanosleep(&pause, NULL);
+	}
+	unsigned long frames = atomic_load(&vision_frames);
+	check(frames > 0, "the vision thread compared no frames");
+	check(seen_motion > 0, "no motion seen");
+	printf("vision: %lu frames compared, motion in %lu of %d reads\n", frames, seen_motion, MOTION_READS);
+}
+/******************************************************/
+int main()
+{
+	sim_config config;
+	sim_default_config(&config);
+	config.duration = 1e9; // the checks poll the clock far more than a run would, keep them from reaching the end
+	sim_reset(&config);
+
+	check_snapshots();
+	check_motion();
+	if (failures) fprintf(stderr, "re_threads: %d failures\n", failures);
+	else printf("ok\n");
+	return failures ? 1 : 0;
+}
@@ -47,6 +47,14 @@ typedef struct behavior{
 	bool is_active;
 } behavior;
 
+//a motor command holds the servo positions and duration requested by the last drive() call of a tick
+typedef struct motor_command{
+	int left_position;	//servo position for the left motor
+	int right_position;	//servo position for the right motor
+	int duration;		//how long (ms) to wait before arbitrating again
+	bool is_pending;	//true once drive() has been called this tick, cleared when the command is sent to the servos
+} motor_command;
+
 //this comparator function is used in the qsort function for sorting our behavior list.  Active things always go before inactive things, and if both are active then the are ordered by rank.
 int compare_ranks(const void *a, const void *b)  
 { 	
@@ -68,6 +76,7 @@ bool is_above_photo_differential(int threshold); //return true if the absolute d
 bool is_front_bump();	//return true if the front bumper was hit
 bool is_back_bump();	//return true if the back bumper was hit
 bool timer_elapsed();	//return true if our timer has elapsed
+void wait_for_next_tick();	//sleep until the next sensing tick or the end of the running action
 
 //ACTIONS
 void escape_front();
@@ -82,6 +91,8 @@ void stop();
 
 //MOTOR CONTROL
 void drive(float left, float right, float delay_seconds); //drive with a certain motor speed for a number of seconds
+void commit_motor_command(); //send the one command collected this tick to the servos
+void enable_motors(); //enable both servos and forget their cached positions
 
 //HELPER FUNCTIONS
 float map(float value, float start_range_low, float start_range_high, float target_range_low, float target_range_high); //remap a value from a source range to a new range
@@ -90,6 +101,7 @@ float map(float value, float start_range_low, float start_range_high, float targ
 void update_gui(); //this function contains our gui update feature
 void print_subsumption_hierarchy(struct behavior *array, size_t len);
 void print_set_hierarchy();
+void print_loop_stats(int row);
 void randomize_hierarchy();
 
 //*************************************************** Variable Definitions ****************************************************/
@@ -107,6 +119,20 @@ float photo_max = 200.0; 		//approximate max possible photo reading (set from ob
 int timer_duration = 500;		//the time in milliseconds to wait between calling action commands.  This value is changed by each drive command called by actions
 unsigned long start_time = 0;	//store the system time each time we start an action so we can see if our time has elapsed without a blocking delay
 
+motor_command pending_command = {0, 0, 0, false};	//the command drive() has collected this tick, only the last one is sent to the servos
+int last_left_position = -1;			//the position last written to the left servo, -1 means unknown so the next command is always written
+int last_right_position = -1;			//the position last written to the right servo
+unsigned long servo_writes = 0;			//number of set_servo_position calls actually made
+unsigned long suppressed_writes = 0;	//number of servo writes skipped because the servo was already at that position
+unsigned long superseded_commands = 0;	//number of drive() calls overwritten by a later drive() in the same tick
+
+int control_rate = 100;				//how many times per second the control loop senses and arbitrates (Hz, 1 to 1000).  The loop sleeps between ticks instead of spinning
+unsigned long next_tick_time = 0;	//the system time (ms) at which the next fixed sensing tick is due
+unsigned long tick_count = 0;		//number of ticks the control loop has run
+unsigned long overrun_count = 0;	//number of ticks that started a whole period or more late (the loop body took too long)
+unsigned long max_jitter = 0;		//the latest (ms) any tick has woken up after its deadline
+unsigned long total_jitter = 0;		//sum of all tick lateness (ms), divide by tick_count for the average
+
 //this struct defines the initial behavior, but also describes all possible behaviors.  New ones could be added, or the order can be moved around.
 //this behavior runs once at the beginning of the program until the gui is accessed.  There is no need to change the rank value manually, just change the order and set
 //the ones you want to be active to "true".  The element at the top is at the top of the hierarchy.
@@ -136,20 +162,22 @@ int main()
 	front_bump_value = 1000;
 	back_bump_value = 1000;
 	
-	enable_servo(LEFT_MOTOR_PIN);	//initialize both motors and set speed to zero
-	enable_servo(RIGHT_MOTOR_PIN);
+	enable_motors();	//initialize both motors and set speed to zero
 	drive(0.0,0.0,1.0);
+	commit_motor_command();
+	next_tick_time = systime(); //the first tick is due right away
 	
 	while(true){ //this is an infinite loop (true is always true)
+		wait_for_next_tick(); //sleep until the next sensing tick or until the running action ends, whichever comes first
 		update_gui(); //update our gui in any case
 		
 		if(!show_gui){ //if we aren't showing the gui, we must be sensing and acting
 			
 			if(update_operating_console){
 				//only enable the servos once when returning from the gui menu, this boolean is disabled in the next print_set_hierarchy function
-				enable_servo(LEFT_MOTOR_PIN);
-				enable_servo(RIGHT_MOTOR_PIN);
+				enable_motors();
 				drive(0.0,0.0,2.0);
+				commit_motor_command(); //start the pause now so this tick's arbitration waits for it
 			}
 			print_set_hierarchy(); //print the current subsumption hierarchy to the screen (only executes if gui has been accessed once before)
 			
@@ -198,12 +226,14 @@ int main()
 					} //end if active
 					if(execute_action){
 						break; //if any action was executed, break out of the subsumption hierarchy loop altogether
-					}//end if execute action	
-					else{
-						stop(); //if there is no action, stop
-					}
+					}//end if execute action
 				} //end for each item in hierarchy loop
+				if(!execute_action){
+					stop(); //if no behavior fired, stop
+				}
 			}//end if timer elapsed
+			
+			commit_motor_command(); //send the one command collected this tick to the servos
 		}//end if not show gui
 		
 		else{
@@ -218,19 +248,80 @@ bool timer_elapsed(){
 	return (systime() > (start_time + timer_duration)); //return true if the current time is greater than our start time plus timer duration
 }
 /******************************************************/
+void wait_for_next_tick(){
+	int rate = control_rate < 1 ? 1 : (control_rate > 1000 ? 1000 : control_rate); //systime() counts whole ms, so 1000 Hz is the fastest tick
+	unsigned long period = 1000 / rate; //length of one sensing tick in ms
+	unsigned long now = systime();
+	unsigned long deadline = next_tick_time;
+	unsigned long action_deadline = start_time + timer_duration + 1; //first time at which timer_elapsed() will return true
+	
+	//wake up early if the running action ends before the next sensing tick, so arbitration is not delayed by up to a whole period
+	if(!show_gui && action_deadline > now && action_deadline < deadline){
+		deadline = action_deadline;
+	}
+	if(deadline > now){
+		msleep(deadline - now); //give the processor back to the GUI and anything else running on the link
+		now = systime();
+	}
+	
+	//keep track of how late we woke up compared to when we wanted to
+	unsigned long jitter = (now > deadline)? now - deadline : 0;
+	total_jitter += jitter;
+	if(jitter > max_jitter) max_jitter = jitter;
+	tick_count++;
+	
+	if(now >= next_tick_time + period){
+		overrun_count++; //we missed at least one whole tick, so start counting again from now instead of running a burst of late ticks
+		next_tick_time = now + period;
+	}
+	else if(now >= next_tick_time){
+		next_tick_time += period; //stay on the fixed grid of ticks so the rate doesn't drift
+	}
+}
+/******************************************************/
 void drive(float left, float right, float delay_seconds){
 	//850 is full motor speed clockwise, 1050 is stopped,  1250 is full motor speed counterclockwise
 	//servo is stopped from ~1044 to 1055
 	float left_speed = map(left, -1.0, 1.0, 850.0, 1250.0); //call the map function to map our speed (set between -1 and 1) to the appropriate range of motor values
 	float right_speed = map(right, -1.0, 1.0, 1250.0, 850.0);
 	
-	timer_duration = (int)(delay_seconds * 1000.0); //multiply our desired time in seconds by 1000 to get milliseconds and update this global variable
+	if(pending_command.is_pending) superseded_commands++; //an earlier drive() this tick never reaches the servos
+	pending_command.left_position = (int)left_speed;
+	pending_command.right_position = (int)right_speed;
+	pending_command.duration = (int)(delay_seconds * 1000.0); //multiply our desired time in seconds by 1000 to get milliseconds
+	pending_command.is_pending = true; //the servos are written once per tick by commit_motor_command()
+}
+/******************************************************/
+void commit_motor_command(){
+	if(!pending_command.is_pending) return; //nobody called drive() this tick, keep doing what we were doing
+	
+	timer_duration = pending_command.duration; //update the global timer so timer_elapsed() knows how long this action runs
 	start_time = systime(); //update our start time to reflect the time we start driving (in ms)
 	front_bump_value = 1000; //reset our sticky bumper values so we start this cycle as if we have not hit anything (hits read out <400)
 	back_bump_value = 1000; 
 	
-	set_servo_position(LEFT_MOTOR_PIN, left_speed); //set the servos to run at the mapped speed
-	set_servo_position(RIGHT_MOTOR_PIN, right_speed);
+	//only talk to a servo if its position actually changes
+	if(pending_command.left_position != last_left_position){
+		set_servo_position(LEFT_MOTOR_PIN, pending_command.left_position);
+		last_left_position = pending_command.left_position;
+		servo_writes++;
+	}
+	else suppressed_writes++;
+	if(pending_command.right_position != last_right_position){
+		set_servo_position(RIGHT_MOTOR_PIN, pending_command.right_position);
+		last_right_position = pending_command.right_position;
+		servo_writes++;
+	}
+	else suppressed_writes++;
+	
+	pending_command.is_pending = false;
+}
+/******************************************************/
+void enable_motors(){
+	enable_servo(LEFT_MOTOR_PIN);
+	enable_servo(RIGHT_MOTOR_PIN);
+	last_left_position = -1; //we don't know where the servos are after being re-enabled, so the next command must be written
+	last_right_position = -1;
 }
 /******************************************************/
 void read_sensors(){
@@ -484,6 +575,13 @@ void print_subsumption_hierarchy(struct behavior *array, size_t len){
 		}
 		//display_printf(35, i, "%d", array[i].rank); //debug for showing rank
 	}
+	print_loop_stats(len + 1);
+}
+//-------------------------MANAGE SCREEN PRINTING OF LOOP TIMING--------------------
+void print_loop_stats(int row){
+	unsigned long average_jitter = tick_count? total_jitter / tick_count : 0;
+	display_printf(0, row, "Ticks: %lu  Overruns: %lu  Jitter avg/max: %lu/%lu ms   ", tick_count, overrun_count, average_jitter, max_jitter);
+	display_printf(0, row + 1, "Servo writes: %lu  Suppressed: %lu  Superseded: %lu   ", servo_writes, suppressed_writes, superseded_commands);
 }
 //--------------------MANAGE SCREEN PRINTING WHEN OPERATING---------------------
 void print_set_hierarchy(){ 